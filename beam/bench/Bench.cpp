@@ -0,0 +1,426 @@
+#include "Common.hpp"
+#include "raytracing/Scene.hpp"
+#include "RNG.hpp"
+
+// Measures ray throughput of the intersection kernels and of full scene
+// queries, and prints the results as CSV or JSON so they can be compared
+// between builds.
+
+namespace beam::bench {
+
+    enum class RaySet {
+        // Rays from a single point through a regular grid, like camera rays
+        Coherent,
+        // Rays from random points in random directions, like bounced rays
+        Incoherent,
+    };
+
+    struct Result {
+        std::string Benchmark;
+        RaySet      Rays;
+        UCount      Primitives;
+        UCount      Tests;
+        UCount      Hits;
+        Float64     Seconds;
+
+        inline Float64 GetRaysPerSecond() const {
+            return Float64(Tests) / Seconds;
+        }
+    };
+
+    struct Options {
+        bool        JSON        = false;
+        std::string OutputPath;
+        UCount      RayCount    = 1u << 14;
+        UCount      MaxSize     = 1000000u;
+        Float64     MinSeconds  = 0.25;
+        UInt32      Seed        = 1u;
+    };
+
+    static const char* ray_set_name(RaySet set) {
+        return set == RaySet::Coherent ? "coherent" : "incoherent";
+    }
+
+    static Vec3 random_point(const AABB& bounds, RNG& rng) {
+        return {
+            rng.Generate(bounds.XMin, bounds.XMax),
+            rng.Generate(bounds.YMin, bounds.YMax),
+            rng.Generate(bounds.ZMin, bounds.ZMax),
+        };
+    }
+
+    static Vec3 random_direction(RNG& rng) {
+        const Float32
+            z   = rng.Generate(-1.0f, 1.0f),
+            phi = rng.Generate(0.0f, 2.0f * glm::pi<Float32>()),
+            r   = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        return { r * std::cos(phi), r * std::sin(phi), z };
+    }
+
+    static std::vector<Ray> make_rays(RaySet set, const AABB& bounds,
+            UCount count, RNG& rng) {
+        std::vector<Ray> rays;
+        rays.reserve(count);
+        if (set == RaySet::Incoherent) {
+            for (UIndex i = 0u; i < count; i++)
+                rays.emplace_back(random_point(bounds, rng),
+                    random_direction(rng));
+            return rays;
+        }
+        // Look at the bounds from in front of them, through a grid that
+        // covers their extent, in scanline order.
+        const Vec3
+            center = bounds.GetCenter(),
+            extent = bounds.GetMax() - bounds.GetMin(),
+            origin = center - Vec3(0.0f, 0.0f, 1.5f * extent.z + 1.0f);
+        const UCount side = std::max<UCount>(1u,
+            UCount(std::sqrt(Float64(count))));
+        for (UIndex i = 0u; i < count; i++) {
+            const Float32
+                u = (Float32(i % side) + 0.5f) / Float32(side) - 0.5f,
+                v = (Float32(i / side % side) + 0.5f) / Float32(side) - 0.5f;
+            const Vec3 target = center + Vec3(u * extent.x, v * extent.y, 0.0f);
+            rays.emplace_back(origin, glm::normalize(target - origin));
+        }
+        return rays;
+    }
+
+    // Runs the benchmark repeatedly until enough time has passed, and
+    // returns the result of all runs combined. A run returns its hit count,
+    // which also keeps the compiler from optimizing the work away.
+    template <typename RunFunc>
+    static Result measure(const Options& options, const std::string& name,
+            RaySet set, UCount primitives, UCount tests_per_run,
+            RunFunc&& run) {
+        using Clock = std::chrono::high_resolution_clock;
+        Result result { name, set, primitives, 0u, 0u, 0.0 };
+        const auto start = Clock::now();
+        do {
+            result.Hits  += run();
+            result.Tests += tests_per_run;
+            result.Seconds = std::chrono::duration<Float64>(
+                Clock::now() - start
+            ).count();
+        } while (result.Seconds < options.MinSeconds);
+        std::cerr << name << " (" << ray_set_name(set) << ", " << primitives
+            << "): " << result.GetRaysPerSecond() * 1.0e-6 << " Mrays/s"
+            << std::endl;
+        return result;
+    }
+
+    // Tests every ray against every primitive of a small set, so that the
+    // cost of a single kernel call is measured.
+    template <typename PrimitiveT, typename TestFunc>
+    static Result measure_kernel(const Options& options,
+            const std::string& name, RaySet set,
+            const std::vector<PrimitiveT>& primitives, const AABB& bounds,
+            RNG& rng, TestFunc&& test) {
+        const auto rays = make_rays(set, bounds, options.RayCount, rng);
+        return measure(options, name, set, primitives.size(),
+            primitives.size() * rays.size(), [&] {
+                UCount hits = 0u;
+                for (const auto& primitive : primitives)
+                    for (const auto& ray : rays)
+                        hits += test(primitive, ray) ? 1u : 0u;
+                return hits;
+            });
+    }
+
+    static Triangle random_triangle(const AABB& bounds, Float32 size,
+            RNG& rng) {
+        const Vec3 a = random_point(bounds, rng);
+        return Triangle(Material(), a,
+            a + size * random_direction(rng),
+            a + size * random_direction(rng));
+    }
+
+    static void run_kernels(const Options& options,
+            std::vector<Result>& results) {
+        constexpr UCount primitive_count = 64u;
+        const AABB bounds(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+        for (const RaySet set : { RaySet::Coherent, RaySet::Incoherent }) {
+            RNG rng(options.Seed);
+
+            std::vector<Sphere> spheres;
+            for (UIndex i = 0u; i < primitive_count; i++)
+                spheres.emplace_back(Material(), random_point(bounds, rng),
+                    rng.Generate(0.05f, 0.25f));
+            results.push_back(measure_kernel(options, "sphere", set, spheres,
+                bounds, rng, [](const Sphere& sphere, const Ray& ray) {
+                    Hit hit;
+                    return sphere.Intersect(ray, hit);
+                }));
+
+            std::vector<Plane> planes;
+            for (UIndex i = 0u; i < primitive_count; i++)
+                planes.emplace_back(Material(), random_direction(rng),
+                    random_point(bounds, rng));
+            results.push_back(measure_kernel(options, "plane", set, planes,
+                bounds, rng, [](const Plane& plane, const Ray& ray) {
+                    Hit hit;
+                    return plane.Intersect(ray, hit);
+                }));
+
+            std::vector<Triangle> triangles;
+            for (UIndex i = 0u; i < primitive_count; i++)
+                triangles.push_back(random_triangle(bounds, 0.5f, rng));
+            results.push_back(measure_kernel(options, "triangle", set,
+                triangles, bounds, rng,
+                [](const Triangle& triangle, const Ray& ray) {
+                    Hit hit;
+                    return triangle.Intersect(ray, hit);
+                }));
+
+            // The same triangles in structure of arrays form, tested one at
+            // a time and with the SIMD kernel over the whole range
+            TriangleArray triangle_array;
+            for (const auto& triangle : triangles)
+                triangle_array.Add(triangle);
+            const auto triangle_rays =
+                make_rays(set, bounds, options.RayCount, rng);
+            results.push_back(measure(options, "triangle_array_scalar", set,
+                triangles.size(), triangles.size() * triangle_rays.size(),
+                [&] {
+                    UCount hits = 0u;
+                    for (const auto& ray : triangle_rays) {
+                        Hit hit;
+                        for (UIndex i = 0u; i < triangle_array.GetCount(); i++)
+                            hits += triangle_array.Intersect(i, ray, hit)
+                                ? 1u : 0u;
+                    }
+                    return hits;
+                }));
+            results.push_back(measure(options, "triangle_array", set,
+                triangles.size(), triangles.size() * triangle_rays.size(),
+                [&] {
+                    UCount hits = 0u;
+                    for (const auto& ray : triangle_rays) {
+                        Hit hit;
+                        hits += triangle_array.IntersectRange(0u,
+                            triangle_array.GetCount(), ray, hit) ? 1u : 0u;
+                    }
+                    return hits;
+                }));
+
+            std::vector<AABB> boxes;
+            for (UIndex i = 0u; i < primitive_count; i++) {
+                AABB box = AABB::Nothing();
+                box.Combine(random_point(bounds, rng));
+                box.Combine(random_point(bounds, rng));
+                boxes.push_back(box);
+            }
+            results.push_back(measure_kernel(options, "aabb", set, boxes,
+                bounds, rng, [](const AABB& box, const Ray& ray) {
+                    return box.Intersects(ray);
+                }));
+        }
+    }
+
+    // Generates the rays of a thin lens camera for samples spread over the
+    // screen, one at a time and as a batch.
+    static void run_camera(const Options& options,
+            std::vector<Result>& results) {
+        RNG rng(options.Seed);
+        const Camera camera(4.0f / 3.0f, 80.0f, Vec3(0.0f),
+            Vec3(0.0f, 0.0f, 1.0f), 5.0f, 0.1f);
+        std::vector<Vec2> screen, lens;
+        for (UIndex i = 0u; i < options.RayCount; i++) {
+            screen.emplace_back(rng.Generate(0.0f, 1.0f),
+                rng.Generate(0.0f, 1.0f));
+            lens.emplace_back(rng.Generate(0.0f, 1.0f),
+                rng.Generate(0.0f, 1.0f));
+        }
+        results.push_back(measure(options, "camera_scalar", RaySet::Coherent,
+            0u, screen.size(), [&] {
+                UCount hits = 0u;
+                for (UIndex i = 0u; i < screen.size(); i++) {
+                    const Ray ray = camera.ScreenCoordsToRay(screen[i].x,
+                        screen[i].y, lens[i]);
+                    hits += ray.Direction.z > 0.0f ? 1u : 0u;
+                }
+                return hits;
+            }));
+        // Filling the batch maps the lens samples onto the disk, which
+        // ScreenCoordsToRay does for every ray, so it is timed as well
+        CameraSamples samples;
+        CameraRays    rays;
+        samples.Resize(screen.size());
+        results.push_back(measure(options, "camera_batch", RaySet::Coherent,
+            0u, screen.size(), [&] {
+                for (UIndex i = 0u; i < screen.size(); i++)
+                    samples.Set(i, screen[i].x, screen[i].y, lens[i]);
+                camera.GenerateRays(samples, rays);
+                UCount hits = 0u;
+                for (const Float32 z : rays.DirectionZ)
+                    hits += z > 0.0f ? 1u : 0u;
+                return hits;
+            }));
+    }
+
+    // Fills a cube with small random triangles and spheres above a ground
+    // plane, with a density that stays the same as the scene grows.
+    static AABB make_scene(Scene& scene, UCount size, RNG& rng) {
+        const Float32 half = 0.5f * std::cbrt(Float32(size));
+        const AABB bounds(-half, half, -half, half, -half, half);
+        for (UIndex i = 0u; i < size; i++) {
+            if (i % 10u == 0u) {
+                scene.Add<Sphere>(Material(), random_point(bounds, rng),
+                    rng.Generate(0.05f, 0.2f));
+            } else {
+                const Triangle triangle = random_triangle(bounds, 0.3f, rng);
+                scene.Add<Triangle>(Material(), triangle.GetA(),
+                    triangle.GetB(), triangle.GetC());
+            }
+        }
+        scene.Add<Plane>(Material(), Vec3(0.0f, 1.0f, 0.0f), half);
+        return bounds;
+    }
+
+    static void run_scenes(const Options& options,
+            std::vector<Result>& results) {
+        ThreadPool pool;
+        for (UCount size = 1000u; size <= options.MaxSize; size *= 10u) {
+            RNG rng(options.Seed);
+            Scene scene;
+            const AABB bounds = make_scene(scene, size, rng);
+
+            const auto start = std::chrono::high_resolution_clock::now();
+            scene.Build(&pool);
+            const std::chrono::duration<Float64> build_time =
+                std::chrono::high_resolution_clock::now() - start;
+            std::cerr << "Built scene of " << size << " primitives in "
+                << build_time.count() * 1.0e3 << " ms" << std::endl;
+            scene.PrintBuildStats(std::cerr);
+
+            for (const RaySet set : { RaySet::Coherent, RaySet::Incoherent }) {
+                const auto rays =
+                    make_rays(set, bounds, options.RayCount, rng);
+                results.push_back(measure(options, "scene", set, size + 1u,
+                    rays.size(), [&] {
+                        UCount hits = 0u;
+                        for (const auto& ray : rays) {
+                            Hit hit;
+                            hits += scene.Intersect(ray, hit) ? 1u : 0u;
+                        }
+                        return hits;
+                    }));
+                // The same rays as shadow rays, which only need any hit
+                results.push_back(measure(options, "scene_occlusion", set,
+                    size + 1u, rays.size(), [&] {
+                        UCount hits = 0u;
+                        for (const auto& ray : rays)
+                            hits += scene.Intersects(ray) ? 1u : 0u;
+                        return hits;
+                    }));
+            }
+        }
+    }
+
+    static void write_csv(std::ostream& stream,
+            const std::vector<Result>& results) {
+        stream << "benchmark,rays,primitives,tests,hits,seconds,"
+            "rays_per_second\n";
+        for (const auto& result : results) {
+            stream << result.Benchmark << ','
+                << ray_set_name(result.Rays) << ','
+                << result.Primitives << ','
+                << result.Tests << ','
+                << result.Hits << ','
+                << result.Seconds << ','
+                << result.GetRaysPerSecond() << '\n';
+        }
+    }
+
+    static void write_json(std::ostream& stream,
+            const std::vector<Result>& results) {
+        stream << "{\n    \"results\": [\n";
+        for (UIndex i = 0u; i < results.size(); i++) {
+            const Result& result = results[i];
+            stream << "        { "
+                << "\"benchmark\": \"" << result.Benchmark << "\", "
+                << "\"rays\": \"" << ray_set_name(result.Rays) << "\", "
+                << "\"primitives\": " << result.Primitives << ", "
+                << "\"tests\": " << result.Tests << ", "
+                << "\"hits\": " << result.Hits << ", "
+                << "\"seconds\": " << result.Seconds << ", "
+                << "\"rays_per_second\": " << result.GetRaysPerSecond()
+                << " }" << (i + 1u < results.size() ? "," : "") << '\n';
+        }
+        stream << "    ]\n}\n";
+    }
+
+    static void print_usage() {
+        std::cerr
+            << "Usage: beam_bench [options]\n"
+            << "Options:\n"
+            << "  --format <csv|json>  Output format, CSV by default.\n"
+            << "  --out <path>         Write results to a file instead of"
+               " stdout.\n"
+            << "  --rays <n>           Number of rays per ray set.\n"
+            << "  --max-size <n>       Largest scene size to benchmark.\n"
+            << "  --min-time <s>       Minimum time to run each benchmark.\n"
+            << "  --seed <n>           Seed for the generated rays and"
+               " scenes.\n";
+    }
+
+    static std::optional<Options> parse_options(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc)
+                return std::nullopt;
+            const std::string value = argv[++i];
+            try {
+                if (arg == "--format" && (value == "csv" || value == "json"))
+                    options.JSON = value == "json";
+                else if (arg == "--out")
+                    options.OutputPath = value;
+                else if (arg == "--rays")
+                    options.RayCount = std::max<UCount>(1u, std::stoull(value));
+                else if (arg == "--max-size")
+                    options.MaxSize = std::stoull(value);
+                else if (arg == "--min-time")
+                    options.MinSeconds = std::stod(value);
+                else if (arg == "--seed")
+                    options.Seed = UInt32(std::stoul(value));
+                else
+                    return std::nullopt;
+            } catch (const std::exception&) {
+                return std::nullopt;
+            }
+        }
+        return options;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    using namespace beam;
+    using namespace beam::bench;
+
+    const auto options = parse_options(argc, argv);
+    if (!options) {
+        print_usage();
+        return -1;
+    }
+
+    std::vector<Result> results;
+    run_kernels(*options, results);
+    run_camera(*options, results);
+    run_scenes(*options, results);
+
+    std::ofstream file;
+    if (!options->OutputPath.empty()) {
+        file.open(options->OutputPath);
+        if (!file.is_open()) {
+            std::cerr << "Can't open output file." << std::endl;
+            return -1;
+        }
+    }
+    std::ostream& stream = file.is_open() ? file : std::cout;
+    if (options->JSON)
+        write_json(stream, results);
+    else
+        write_csv(stream, results);
+    return 0;
+}
@@ -5,8 +5,14 @@
 #include <fstream>
 #include <filesystem>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <utility>
 #include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
 #include <functional>
 #include <string>
 #include <array>
@@ -15,6 +21,8 @@
 #include <unordered_set>
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
+#include <cctype>
 #include <type_traits>
 #include <exception>
 #include <optional>
@@ -28,6 +36,8 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtx/norm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #if defined(BEAM_CONFIG_DEBUG)
 #define BEAM_DEBUG_ONLY if constexpr (true)
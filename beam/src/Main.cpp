@@ -1,103 +1,429 @@
 #include "Common.hpp"
 #include "raytracing/Camera.hpp"
 #include "raytracing/Raytracing.hpp"
-#include "raytracing/Objects.hpp"
+#include "raytracing/Scene.hpp"
+#include "raytracing/Integrator.hpp"
+#include "raytracing/Wavefront.hpp"
 #include "rendering/Color.hpp"
 #include "rendering/Renderer.hpp"
 #include "rendering/PixelBuffer.hpp"
-#include "RNG.hpp"
+#include "rendering/AccumulationBuffer.hpp"
+#include "rendering/ImageWriter.hpp"
+#include "ThreadPool.hpp"
+#include "Sampler.hpp"
 #include "SceneParser.hpp"
+#include "SceneCache.hpp"
 
-int main(int argc, char** argv) {
-    using namespace beam;
+namespace beam {
 
-    if (argc != 2) {
-        std::cerr << "You need to specify a scene file." << std::endl;
-        return -1;
+    struct Options {
+        std::string ScenePath;
+        bool        Headless    = false;
+        std::string OutputPath  = "image.pfm";
+        UInt32      Samples     = 16u;
+        UInt32      MinSamples  = 16u;
+        Float32     MaxError    = 0.0f;
+        UInt32      Seed        = 0u;
+        UCount      Width       = 640u;
+        UCount      Height      = 480u;
+        UCount      ThreadCount = 0u;
+        std::string Integrator  = "path";
+        UInt32      MaxDepth    = 8u;
+        std::string Sampler     = "sobol";
+        std::string Lights      = "power";
+        Float32     Aperture    = 0.1f;
+        Float32     Focus       = 5.0f;
+    };
+
+    static constexpr Color sky_color = colors::Black;
+
+    static void print_usage() {
+        std::cerr
+            << "Usage: beam [options] <scene file>\n"
+            << "       beam convert <scene file> <output.beamb>\n"
+            << "Options:\n"
+            << "  --headless      Render a single image without a window.\n"
+            << "  --out <path>    Output image for headless mode (.pfm, .ppm"
+               " or .exr).\n"
+            << "  --spp <n>       Samples per pixel for headless mode; the"
+               " maximum\n"
+            << "                  when adaptive sampling is on.\n"
+            << "  --min-spp <n>   Samples every pixel gets before adaptive"
+               " sampling\n"
+            << "                  decides whether it needs more.\n"
+            << "  --error <e>     Turns on adaptive sampling: pixels stop"
+               " getting samples\n"
+            << "                  once their relative standard error is"
+               " below e.\n"
+            << "  --seed <n>      Random seed.\n"
+            << "  --width <n>     Image width for headless mode.\n"
+            << "  --height <n>    Image height for headless mode.\n"
+            << "  --threads <n>   Number of render threads; 0 uses all.\n"
+            << "  --integrator <name>\n"
+            << "                  path (the default) for path tracing,"
+               " wavefront for path\n"
+            << "                  tracing in stages over many paths at once,"
+               " or preview\n"
+            << "                  for the unlit colors of the surfaces.\n"
+            << "  --max-depth <n> Maximum number of bounces of a path.\n"
+            << "  --sampler <name>\n"
+            << "                  sobol (the default), halton, stratified or"
+            " independent;\n"
+            << "                  how the samples of a pixel are spread"
+            " out.\n"
+            << "  --lights <name> power (the default) picks lights by their"
+               " power, tree by\n"
+            << "                  their estimated contribution at each point,"
+               " which is\n"
+            << "                  better with many lights.\n"
+            << "  --aperture <r>  Radius of the camera lens; 0 gives a pinhole"
+               " camera.\n"
+            << "  --focus <d>     Distance from the camera to the plane in"
+               " focus.\n";
     }
 
-    const std::string scene_path = argv[1];
-    auto scene_update_time = std::filesystem::last_write_time(scene_path);
-
-    Renderer renderer;
-
-    constexpr UCount
-        width  = 640,
-        height = 480;
-
-    constexpr Color sky_color = colors::Black;
-
-    PixelBuffer buffer(width, height);
-
-    Camera camera(
-        Float32(width) / Float32(height),
-        80.0f,
-        { 0.0f, 0.0f, -3.0f },
-        { 0.0f, 0.0f,  1.0f },
-        5.0f,
-        0.1f
-    );
-
-    Scene scene;
-    parse_scene(scene, argv[1]);
-
-    RNG rng;
-
-    auto lt = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<Float32> ft = lt - lt;
-    while (!renderer.IsWindowCloseRequested()) {
-        const Float32 dt = ft.count();
-        constexpr Float32 speed     = 15.0f;
-        constexpr Float32 rot_speed = 360.0f;
-        Vec3 movement = Vec3(0.0f, 0.0f, 0.0f);
-        if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_Q))
-            camera.RotateHorizontally(dt * -rot_speed);
-        if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_E))
-            camera.RotateHorizontally(dt * rot_speed);
-        if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_R))
-            camera.RotateVertically(dt * rot_speed);
-        if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_F))
-            camera.RotateVertically(dt * -rot_speed);
-        if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_A))
-            movement.x -= 1.0f;
-        if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_D))
-            movement.x += 1.0f;
-        if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_SPACE))
-            movement.y += 1.0f;
-        if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_LEFT_CONTROL))
-            movement.y -= 1.0f;
-        if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_W))
-            movement.z += 1.0f;
-        if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_S))
-            movement.z -= 1.0f;
-        if (movement != Vec3 { 0.0f, 0.0f, 0.0f }) {
-            movement = glm::normalize(movement);
-            camera.Move(dt * speed * movement);
+    static std::optional<Options> parse_options(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            const auto next = [&]() -> std::optional<std::string> {
+                if (i + 1 >= argc)
+                    return std::nullopt;
+                return std::string(argv[++i]);
+            };
+            const auto next_number = [&]() -> std::optional<UInt64> {
+                const auto value = next();
+                if (!value)
+                    return std::nullopt;
+                try {
+                    return std::stoull(*value);
+                } catch (const std::exception&) {
+                    return std::nullopt;
+                }
+            };
+            const auto next_float = [&]() -> std::optional<Float32> {
+                const auto value = next();
+                if (!value)
+                    return std::nullopt;
+                try {
+                    return std::stof(*value);
+                } catch (const std::exception&) {
+                    return std::nullopt;
+                }
+            };
+            std::optional<UInt64>  number;
+            std::optional<Float32> real;
+            if (arg == "--headless") {
+                options.Headless = true;
+            } else if (arg == "--out") {
+                const auto value = next();
+                if (!value)
+                    return std::nullopt;
+                options.OutputPath = *value;
+            } else if (arg == "--spp") {
+                if (!(number = next_number()) || *number == 0u)
+                    return std::nullopt;
+                options.Samples = UInt32(*number);
+            } else if (arg == "--min-spp") {
+                if (!(number = next_number()) || *number == 0u)
+                    return std::nullopt;
+                options.MinSamples = UInt32(*number);
+            } else if (arg == "--error") {
+                if (!(real = next_float()) || !(*real >= 0.0f))
+                    return std::nullopt;
+                options.MaxError = *real;
+            } else if (arg == "--seed") {
+                if (!(number = next_number()))
+                    return std::nullopt;
+                options.Seed = UInt32(*number);
+            } else if (arg == "--width") {
+                if (!(number = next_number()) || *number == 0u)
+                    return std::nullopt;
+                options.Width = UCount(*number);
+            } else if (arg == "--height") {
+                if (!(number = next_number()) || *number == 0u)
+                    return std::nullopt;
+                options.Height = UCount(*number);
+            } else if (arg == "--threads") {
+                if (!(number = next_number()))
+                    return std::nullopt;
+                options.ThreadCount = UCount(*number);
+            } else if (arg == "--integrator") {
+                const auto value = next();
+                if (!value || (*value != "path" && *value != "wavefront"
+                        && *value != "preview"))
+                    return std::nullopt;
+                options.Integrator = *value;
+            } else if (arg == "--sampler") {
+                const auto value = next();
+                if (!value || (*value != "sobol" && *value != "halton"
+                        && *value != "stratified" && *value != "independent"))
+                    return std::nullopt;
+                options.Sampler = *value;
+            } else if (arg == "--lights") {
+                const auto value = next();
+                if (!value || (*value != "power" && *value != "tree"))
+                    return std::nullopt;
+                options.Lights = *value;
+            } else if (arg == "--max-depth") {
+                if (!(number = next_number()))
+                    return std::nullopt;
+                options.MaxDepth = UInt32(*number);
+            } else if (arg == "--aperture") {
+                if (!(real = next_float()) || !(*real >= 0.0f))
+                    return std::nullopt;
+                options.Aperture = *real;
+            } else if (arg == "--focus") {
+                if (!(real = next_float()) || !(*real > 0.0f))
+                    return std::nullopt;
+                options.Focus = *real;
+            } else if (arg.rfind("--", 0) == 0 || !options.ScenePath.empty()) {
+                return std::nullopt;
+            } else {
+                options.ScenePath = arg;
+            }
+        }
+        if (options.ScenePath.empty()) {
+            std::cerr << "You need to specify a scene file." << std::endl;
+            return std::nullopt;
         }
+        return options;
+    }
+
+    // Loads a scene and reports how long building it took.
+    static bool load_scene(Scene& scene, const std::string& path,
+            ThreadPool& pool) {
+        if (!parse_scene(scene, path, &pool))
+            return false;
+        scene.PrintBuildStats(std::cout);
+        return true;
+    }
 
-        scene.Trace(camera, sky_color, rng, buffer);
+    // Writes a scene to a binary scene cache file that loads much faster.
+    static int run_convert(const std::string& input,
+            const std::string& output, ThreadPool& pool) {
+        Scene scene;
+        if (!load_scene(scene, input, pool))
+            return -1;
+        if (!save_scene_cache(scene, output))
+            return -1;
+        std::cout << "Wrote " << scene.GetSpheres().GetCount()
+            << " spheres, " << scene.GetPlanes().GetCount() << " planes, "
+            << scene.GetTriangles().GetCount() << " triangles, "
+            << scene.GetMeshes().size() << " meshes and "
+            << scene.GetInstances().size() << " mesh instances to " << output
+            << "." << std::endl;
+        return 0;
+    }
+
+    static std::unique_ptr<Integrator> make_integrator(
+            const Options& options) {
+        if (options.Integrator == "preview")
+            return std::make_unique<PreviewIntegrator>();
+        return std::make_unique<PathIntegrator>(options.MaxDepth);
+    }
 
-        renderer.Render(buffer);
-        renderer.SwapBuffers();
+    static std::unique_ptr<Sampler> make_sampler(const Options& options) {
+        if (options.Sampler == "halton")
+            return std::make_unique<HaltonSampler>(options.Seed);
+        if (options.Sampler == "stratified")
+            return std::make_unique<StratifiedSampler>(options.Seed,
+                options.Samples);
+        if (options.Sampler == "independent")
+            return std::make_unique<IndependentSampler>(options.Seed);
+        return std::make_unique<SobolSampler>(options.Seed);
+    }
+
+    static std::unique_ptr<LightSampler> make_light_sampler(
+            const Options& options) {
+        if (options.Lights == "tree")
+            return std::make_unique<LightTree>();
+        return std::make_unique<LightTable>();
+    }
+
+    static Camera make_camera(const Options& options, UCount width,
+            UCount height) {
+        return Camera(
+            Float32(width) / Float32(height),
+            80.0f,
+            { 0.0f, 0.0f, -3.0f },
+            { 0.0f, 0.0f,  1.0f },
+            options.Focus,
+            options.Aperture
+        );
+    }
+
+    static int run_headless(const Options& options, ThreadPool& pool) {
+        Scene scene;
+        scene.SetLightSampler(make_light_sampler(options));
+        if (!load_scene(scene, options.ScenePath, pool))
+            return -1;
+
+        PixelBuffer        buffer(options.Width, options.Height);
+        AccumulationBuffer accumulation(options.Width, options.Height);
+        const Camera camera = make_camera(options, options.Width,
+            options.Height);
+        const auto integrator = make_integrator(options);
+        const auto sampler    = make_sampler(options);
+
+        // Render in passes until every pixel has converged or reached the
+        // requested number of samples
+        TraceSettings settings;
+        settings.MinSamples      =
+            std::min(options.MinSamples, options.Samples);
+        settings.SamplesPerPixel = std::min(settings.MinSamples, 16u);
+        settings.ErrorThreshold  = options.MaxError;
+        settings.MaxSamples      = options.Samples;
+
+        // The wavefront path tracer renders whole passes itself, the other
+        // integrators are called by the scene for every sample
+        WavefrontPathTracer wavefront { PathIntegrator(options.MaxDepth) };
+        const auto trace = [&] {
+            if (options.Integrator == "wavefront")
+                return wavefront.Trace(scene, camera, sky_color, *sampler,
+                    settings, pool, accumulation, buffer);
+            return scene.Trace(camera, sky_color, *integrator, *sampler,
+                settings, pool, accumulation, buffer);
+        };
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        UCount total_samples = 0u;
+        while (const UCount samples = trace())
+            total_samples += samples;
+        const auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Render time: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                end - start
+            ).count()
+            << " ms, "
+            << Float64(total_samples) / Float64(options.Width * options.Height)
+            << " samples per pixel on average" << std::endl;
+
+        if (!write_image(buffer, options.OutputPath))
+            return -1;
+        return 0;
+    }
 
-        if (std::filesystem::exists(scene_path)) {
-            const auto update_time =
-                std::filesystem::last_write_time(scene_path);
-            if (update_time > scene_update_time) {
-                scene_update_time = update_time;
-                parse_scene(scene, argv[1]);    
+    static int run_interactive(const Options& options, ThreadPool& pool) {
+        const std::string& scene_path = options.ScenePath;
+        auto scene_update_time = std::filesystem::last_write_time(scene_path);
+
+        Renderer renderer;
+
+        constexpr UCount
+            width  = 640,
+            height = 480;
+
+        PixelBuffer        buffer(width, height);
+        AccumulationBuffer accumulation(width, height);
+
+        Camera camera = make_camera(options, width, height);
+        const auto integrator = make_integrator(options);
+        const auto sampler    = make_sampler(options);
+
+        Scene scene;
+        scene.SetLightSampler(make_light_sampler(options));
+        load_scene(scene, scene_path, pool);
+
+        TraceSettings settings;
+        settings.MinSamples     = options.MinSamples;
+        settings.ErrorThreshold = options.MaxError;
+        WavefrontPathTracer wavefront { PathIntegrator(options.MaxDepth) };
+        const auto trace = [&] {
+            if (options.Integrator == "wavefront")
+                return wavefront.Trace(scene, camera, sky_color, *sampler,
+                    settings, pool, accumulation, buffer);
+            return scene.Trace(camera, sky_color, *integrator, *sampler,
+                settings, pool, accumulation, buffer);
+        };
+
+        auto lt = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<Float32> ft = lt - lt;
+        while (!renderer.IsWindowCloseRequested()) {
+            const Float32 dt = ft.count();
+            constexpr Float32 speed     = 15.0f;
+            constexpr Float32 rot_speed = 360.0f;
+            Vec3 movement = Vec3(0.0f, 0.0f, 0.0f);
+            if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_Q))
+                camera.RotateHorizontally(dt * -rot_speed);
+            if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_E))
+                camera.RotateHorizontally(dt * rot_speed);
+            if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_R))
+                camera.RotateVertically(dt * rot_speed);
+            if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_F))
+                camera.RotateVertically(dt * -rot_speed);
+            if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_A))
+                movement.x -= 1.0f;
+            if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_D))
+                movement.x += 1.0f;
+            if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_SPACE))
+                movement.y += 1.0f;
+            if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_LEFT_CONTROL))
+                movement.y -= 1.0f;
+            if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_W))
+                movement.z += 1.0f;
+            if (glfwGetKey(renderer.GetHandle(), GLFW_KEY_S))
+                movement.z -= 1.0f;
+            if (movement != Vec3 { 0.0f, 0.0f, 0.0f }) {
+                movement = glm::normalize(movement);
+                camera.Move(dt * speed * movement);
+            }
+
+            // Samples keep accumulating for as long as the view doesn't
+            // change, so a still image converges.
+            trace();
+
+            renderer.Render(buffer);
+            renderer.SwapBuffers();
+
+            if (std::filesystem::exists(scene_path)) {
+                const auto update_time =
+                    std::filesystem::last_write_time(scene_path);
+                if (update_time > scene_update_time) {
+                    scene_update_time = update_time;
+                    load_scene(scene, scene_path, pool);
+                }
             }
+
+            glfwPollEvents();
+
+            const auto t = std::chrono::high_resolution_clock::now();
+            ft = t - lt;
+            lt = t;
+            std::cout << "Frame time: "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(ft)
+                    .count()
+                << " ms " << std::endl;
         }
 
-        glfwPollEvents();
+        return 0;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    using namespace beam;
+
+    if (argc >= 2 && std::string(argv[1]) == "convert") {
+        if (argc != 4) {
+            print_usage();
+            return -1;
+        }
+        ThreadPool pool;
+        return run_convert(argv[2], argv[3], pool);
+    }
 
-        const auto t = std::chrono::high_resolution_clock::now();
-        ft = t - lt;
-        lt = t;
-        std::cout << "Frame time: "
-            << std::chrono::duration_cast<std::chrono::milliseconds>(ft).count()
-            << " ms " << std::endl;
+    const auto options = parse_options(argc, argv);
+    if (!options) {
+        print_usage();
+        return -1;
     }
 
-    return 0;
+    ThreadPool pool = options->ThreadCount == 0u
+        ? ThreadPool()
+        : ThreadPool(options->ThreadCount);
+
+    if (options->Headless)
+        return run_headless(*options, pool);
+    return run_interactive(*options, pool);
 }
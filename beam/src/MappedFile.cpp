@@ -0,0 +1,94 @@
+#include "Common.hpp"
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace beam {
+
+#if defined(_WIN32)
+
+    MappedFile::MappedFile(const std::string& path)
+        : m_data(nullptr)
+        , m_size(0u)
+        , m_file(INVALID_HANDLE_VALUE)
+        , m_mapping(nullptr)
+    {
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("Can't open file " + path + ".");
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size)) {
+            CloseHandle(m_file);
+            throw std::runtime_error("Can't get size of file " + path + ".");
+        }
+        m_size = USize(size.QuadPart);
+        if (m_size == 0u)
+            return;
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0,
+            nullptr);
+        if (m_mapping)
+            m_data = static_cast<const Byte*>(
+                MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0)
+            );
+        if (!m_data) {
+            if (m_mapping)
+                CloseHandle(m_mapping);
+            CloseHandle(m_file);
+            throw std::runtime_error("Can't map file " + path + ".");
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        if (m_data)
+            UnmapViewOfFile(m_data);
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        CloseHandle(m_file);
+    }
+
+#else
+
+    MappedFile::MappedFile(const std::string& path)
+        : m_data(nullptr)
+        , m_size(0u)
+    {
+        const int file = open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            throw std::runtime_error("Can't open file " + path + ".");
+        struct stat status;
+        if (fstat(file, &status) != 0) {
+            close(file);
+            throw std::runtime_error("Can't get size of file " + path + ".");
+        }
+        m_size = USize(status.st_size);
+        if (m_size == 0u) {
+            close(file);
+            return;
+        }
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+        // The mapping stays valid after the file is closed
+        close(file);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("Can't map file " + path + ".");
+        madvise(data, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const Byte*>(data);
+    }
+
+    MappedFile::~MappedFile() {
+        if (m_data)
+            munmap(const_cast<Byte*>(m_data), m_size);
+    }
+
+#endif
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+namespace beam {
+
+    // A read-only view of a whole file, mapped into memory so its contents
+    // can be used without reading them into a buffer first.
+    class MappedFile {
+    public:
+        // Throws std::runtime_error if the file can't be opened or mapped.
+        MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&)            = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        inline const Byte* GetData() const { return m_data; }
+        inline USize       GetSize() const { return m_size; }
+    private:
+        const Byte* m_data;
+        USize       m_size;
+#if defined(_WIN32)
+        void*       m_file;
+        void*       m_mapping;
+#endif
+    };
+
+}
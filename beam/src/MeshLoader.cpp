@@ -0,0 +1,486 @@
+#include "Common.hpp"
+#include "MeshLoader.hpp"
+#include "MappedFile.hpp"
+
+namespace beam {
+
+    // Both readers work directly on the mapped file. OBJ files are split
+    // into chunks of whole lines that are parsed on the threads of the pool
+    // and then concatenated; binary PLY files are decoded in a single pass.
+
+    static inline bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static inline bool is_digit(char c) {
+        return '0' <= c && c <= '9';
+    }
+
+    static inline void skip_spaces(const char*& p, const char* end) {
+        while (p < end && is_space(*p))
+            p++;
+    }
+
+    static inline void skip_line(const char*& p, const char* end) {
+        while (p < end && *p != '\n')
+            p++;
+        if (p < end)
+            p++;
+    }
+
+    static Float64 pow10(Int32 exponent) {
+        static constexpr Float64 powers[] = {
+            1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,
+            1.0e8,  1.0e9,  1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15,
+            1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22
+        };
+        if (0 <= exponent && exponent <= 22)
+            return powers[exponent];
+        if (-22 <= exponent && exponent < 0)
+            return 1.0 / powers[-exponent];
+        return std::pow(10.0, Float64(exponent));
+    }
+
+    // Parses a decimal number like -1.25e-3. Doesn't need the text to be
+    // null-terminated, unlike the standard library functions.
+    static bool parse_float(const char*& p, const char* end, Float32& value) {
+        const char* start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        // Digits beyond what fits in the mantissa only change the magnitude
+        constexpr UInt64 max_mantissa = 100000000000000000ull;
+        UInt64 mantissa = 0u;
+        Int32  exponent = 0;
+        UCount digits   = 0u;
+        for (; p < end && is_digit(*p); p++, digits++) {
+            if (mantissa < max_mantissa)
+                mantissa = 10u * mantissa + UInt64(*p - '0');
+            else
+                exponent++;
+        }
+        if (p < end && *p == '.') {
+            p++;
+            for (; p < end && is_digit(*p); p++, digits++) {
+                if (mantissa < max_mantissa) {
+                    mantissa = 10u * mantissa + UInt64(*p - '0');
+                    exponent--;
+                }
+            }
+        }
+        if (digits == 0u) {
+            p = start;
+            return false;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            bool negative_exponent = false;
+            if (p < end && (*p == '-' || *p == '+'))
+                negative_exponent = *p++ == '-';
+            Int32 e = 0;
+            while (p < end && is_digit(*p)) {
+                if (e < 10000)
+                    e = 10 * e + (*p - '0');
+                p++;
+            }
+            exponent += negative_exponent ? -e : e;
+        }
+        const Float64 magnitude = Float64(mantissa) * pow10(exponent);
+        value = Float32(negative ? -magnitude : magnitude);
+        return true;
+    }
+
+    static bool parse_int(const char*& p, const char* end, Int64& value) {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        if (p == end || !is_digit(*p))
+            return false;
+        Int64 result = 0;
+        while (p < end && is_digit(*p)) {
+            if (result < (Int64(1) << 40))
+                result = 10 * result + (*p - '0');
+            p++;
+        }
+        value = negative ? -result : result;
+        return true;
+    }
+
+    struct ObjChunk {
+        std::vector<Vec3>  Vertices;
+        // Indices that refer to vertices defined before this chunk are
+        // resolved once the vertex counts of all chunks are known; Relative
+        // lists the positions of the indices that are still relative to the
+        // first vertex of this chunk.
+        std::vector<Int64> Indices;
+        std::vector<UIndex> Relative;
+    };
+
+    static void parse_obj_chunk(const char* p, const char* end,
+            ObjChunk& chunk) {
+        std::vector<Int64> face;
+        std::vector<bool>  face_relative;
+        while (p < end) {
+            skip_spaces(p, end);
+            if (end - p >= 2 && p[0] == 'v' && is_space(p[1])) {
+                p += 2;
+                Vec3 vertex;
+                for (UIndex i = 0u; i < 3u; i++) {
+                    skip_spaces(p, end);
+                    if (!parse_float(p, end, vertex[i]))
+                        throw std::runtime_error("Invalid OBJ vertex.");
+                }
+                chunk.Vertices.push_back(vertex);
+            } else if (end - p >= 2 && p[0] == 'f' && is_space(p[1])) {
+                p += 2;
+                face.clear();
+                face_relative.clear();
+                while (true) {
+                    skip_spaces(p, end);
+                    Int64 index;
+                    if (!parse_int(p, end, index))
+                        break;
+                    // Positive indices count from one; negative ones count
+                    // back from the last vertex defined so far
+                    if (index > 0) {
+                        face.push_back(index - 1);
+                        face_relative.push_back(false);
+                    } else if (index < 0) {
+                        face.push_back(Int64(chunk.Vertices.size()) + index);
+                        face_relative.push_back(true);
+                    } else {
+                        throw std::runtime_error("Invalid OBJ face index.");
+                    }
+                    // Skip texture coordinate and normal indices
+                    while (p < end && !is_space(*p) && *p != '\n')
+                        p++;
+                }
+                if (face.size() < 3u)
+                    throw std::runtime_error("OBJ face with fewer than three "
+                        "vertices.");
+                for (UIndex i = 1u; i + 1u < face.size(); i++) {
+                    for (const UIndex j : { UIndex(0u), i, i + 1u }) {
+                        if (face_relative[j])
+                            chunk.Relative.push_back(chunk.Indices.size());
+                        chunk.Indices.push_back(face[j]);
+                    }
+                }
+            }
+            skip_line(p, end);
+        }
+    }
+
+    static MeshData load_obj(const MappedFile& file, ThreadPool* pool) {
+        constexpr USize chunk_size = USize(1u) << 22u;
+
+        const char* data = reinterpret_cast<const char*>(file.GetData());
+        const char* end  = data + file.GetSize();
+
+        // Split the file into chunks that start at the beginning of a line
+        const UCount chunk_count =
+            std::max<UCount>(1u, file.GetSize() / chunk_size);
+        std::vector<const char*> starts(chunk_count + 1u);
+        starts[0]           = data;
+        starts[chunk_count] = end;
+        for (UIndex i = 1u; i < chunk_count; i++) {
+            const char* p = std::max(data + i * chunk_size, starts[i - 1u]);
+            while (p < end && p[-1] != '\n')
+                p++;
+            starts[i] = p;
+        }
+
+        std::vector<ObjChunk> chunks(chunk_count);
+        const auto parse = [&](UIndex i) {
+            ObjChunk& chunk = chunks[i];
+            // Rough estimates that avoid most reallocations
+            const USize size = USize(starts[i + 1u] - starts[i]);
+            chunk.Vertices.reserve(size / 48u);
+            chunk.Indices.reserve(size / 8u);
+            parse_obj_chunk(starts[i], starts[i + 1u], chunk);
+        };
+        if (!pool || chunk_count == 1u) {
+            for (UIndex i = 0u; i < chunk_count; i++)
+                parse(i);
+        } else {
+            std::exception_ptr error;
+            std::mutex         error_mutex;
+            pool->ParallelFor(chunk_count, [&](UIndex i, UIndex) {
+                try {
+                    parse(i);
+                } catch (...) {
+                    std::lock_guard lock(error_mutex);
+                    error = std::current_exception();
+                }
+            });
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        MeshData mesh;
+        UCount vertex_count = 0u, index_count = 0u;
+        for (const ObjChunk& chunk : chunks) {
+            vertex_count += chunk.Vertices.size();
+            index_count  += chunk.Indices.size();
+        }
+        mesh.Vertices.reserve(vertex_count);
+        mesh.Indices.reserve(index_count);
+        for (ObjChunk& chunk : chunks) {
+            const Int64 offset = Int64(mesh.Vertices.size());
+            for (const UIndex i : chunk.Relative)
+                chunk.Indices[i] += offset;
+            mesh.Vertices.insert(
+                mesh.Vertices.end(),
+                chunk.Vertices.begin(),
+                chunk.Vertices.end()
+            );
+            for (const Int64 index : chunk.Indices) {
+                if (index < 0 || index >= Int64(vertex_count))
+                    throw std::runtime_error("OBJ face index out of range.");
+                mesh.Indices.push_back(UInt32(index));
+            }
+            chunk = ObjChunk();
+        }
+        return mesh;
+    }
+
+    enum class PlyType : UInt8 {
+        Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64
+    };
+
+    static PlyType parse_ply_type(const std::string& name) {
+        if (name == "char"   || name == "int8")    return PlyType::Int8;
+        if (name == "uchar"  || name == "uint8")   return PlyType::UInt8;
+        if (name == "short"  || name == "int16")   return PlyType::Int16;
+        if (name == "ushort" || name == "uint16")  return PlyType::UInt16;
+        if (name == "int"    || name == "int32")   return PlyType::Int32;
+        if (name == "uint"   || name == "uint32")  return PlyType::UInt32;
+        if (name == "float"  || name == "float32") return PlyType::Float32;
+        if (name == "double" || name == "float64") return PlyType::Float64;
+        throw std::runtime_error("Unknown PLY property type " + name + ".");
+    }
+
+    static USize get_ply_type_size(PlyType type) {
+        switch (type) {
+        case PlyType::Int8:
+        case PlyType::UInt8:
+            return 1u;
+        case PlyType::Int16:
+        case PlyType::UInt16:
+            return 2u;
+        case PlyType::Float64:
+            return 8u;
+        default:
+            return 4u;
+        }
+    }
+
+    struct PlyProperty {
+        std::string Name;
+        PlyType     Type;
+        // Lists store their length as CountType followed by that many
+        // values of Type
+        bool        IsList;
+        PlyType     CountType;
+    };
+
+    struct PlyElement {
+        std::string              Name;
+        UCount                   Count;
+        std::vector<PlyProperty> Properties;
+    };
+
+    class PlyReader {
+    public:
+        PlyReader(const Byte* data, const Byte* end, bool big_endian)
+            : m_data(data), m_end(end), m_big_endian(big_endian) { }
+
+        Float64 Read(PlyType type) {
+            const USize size = get_ply_type_size(type);
+            if (USize(m_end - m_data) < size)
+                throw std::runtime_error("PLY file is truncated.");
+            std::array<Byte, 8> bytes;
+            std::copy(m_data, m_data + size, bytes.begin());
+            if (m_big_endian)
+                std::reverse(bytes.begin(), bytes.begin() + size);
+            m_data += size;
+            switch (type) {
+            case PlyType::Int8:    return Float64(As<Int8>(bytes));
+            case PlyType::UInt8:   return Float64(As<UInt8>(bytes));
+            case PlyType::Int16:   return Float64(As<Int16>(bytes));
+            case PlyType::UInt16:  return Float64(As<UInt16>(bytes));
+            case PlyType::Int32:   return Float64(As<Int32>(bytes));
+            case PlyType::UInt32:  return Float64(As<UInt32>(bytes));
+            case PlyType::Float32: return Float64(As<Float32>(bytes));
+            default:               return As<Float64>(bytes);
+            }
+        }
+    private:
+        const Byte* m_data;
+        const Byte* m_end;
+        bool        m_big_endian;
+
+        template <typename T>
+        static T As(const std::array<Byte, 8>& bytes) {
+            T value;
+            std::memcpy(&value, bytes.data(), sizeof(T));
+            return value;
+        }
+    };
+
+    static MeshData load_ply(const MappedFile& file) {
+        const char* const data = reinterpret_cast<const char*>(file.GetData());
+        const char* const end  = data + file.GetSize();
+        const char* p = data;
+
+        const auto next_line = [&]() {
+            const char* line_end = p;
+            while (line_end < end && *line_end != '\n')
+                line_end++;
+            if (line_end == end)
+                throw std::runtime_error("PLY header is truncated.");
+            std::string line(p, line_end);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            p = line_end + 1;
+            return line;
+        };
+
+        if (next_line() != "ply")
+            throw std::runtime_error("Not a PLY file.");
+        bool big_endian = false;
+        std::vector<PlyElement> elements;
+        while (true) {
+            std::istringstream line(next_line());
+            std::string keyword;
+            line >> keyword;
+            if (keyword == "end_header") {
+                break;
+            } else if (keyword == "format") {
+                std::string format;
+                line >> format;
+                if (format == "binary_big_endian")
+                    big_endian = true;
+                else if (format != "binary_little_endian")
+                    throw std::runtime_error("Only binary PLY files are "
+                        "supported.");
+            } else if (keyword == "element") {
+                PlyElement element;
+                line >> element.Name >> element.Count;
+                elements.push_back(element);
+            } else if (keyword == "property") {
+                if (elements.empty())
+                    throw std::runtime_error("PLY property without element.");
+                PlyProperty property;
+                std::string type;
+                line >> type;
+                property.IsList = type == "list";
+                if (property.IsList) {
+                    std::string count_type;
+                    line >> count_type >> type;
+                    property.CountType = parse_ply_type(count_type);
+                }
+                property.Type = parse_ply_type(type);
+                line >> property.Name;
+                elements.back().Properties.push_back(property);
+            }
+            // Comments and other lines are ignored
+        }
+
+        MeshData mesh;
+        PlyReader reader(reinterpret_cast<const Byte*>(p),
+            reinterpret_cast<const Byte*>(end), big_endian);
+        std::vector<Float64> values;
+        for (const PlyElement& element : elements) {
+            const bool
+                is_vertex = element.Name == "vertex",
+                is_face   = element.Name == "face";
+            // Where x, y and z are among the properties of a vertex
+            std::array<UIndex, 3> coordinates = { };
+            if (is_vertex) {
+                mesh.Vertices.reserve(element.Count);
+                for (UIndex i = 0u; i < 3u; i++) {
+                    const std::string name(1u, char('x' + i));
+                    const auto it = std::find_if(
+                        element.Properties.begin(),
+                        element.Properties.end(),
+                        [&](const PlyProperty& property) {
+                            return property.Name == name && !property.IsList;
+                        }
+                    );
+                    if (it == element.Properties.end())
+                        throw std::runtime_error("PLY vertex without " + name
+                            + " coordinate.");
+                    coordinates[i] = UIndex(it - element.Properties.begin());
+                }
+            }
+            if (is_face)
+                mesh.Indices.reserve(3u * element.Count);
+
+            values.resize(element.Properties.size());
+            for (UIndex i = 0u; i < element.Count; i++) {
+                for (UIndex j = 0u; j < element.Properties.size(); j++) {
+                    const PlyProperty& property = element.Properties[j];
+                    if (!property.IsList) {
+                        values[j] = reader.Read(property.Type);
+                        continue;
+                    }
+                    const UCount count =
+                        UCount(std::max(0.0, reader.Read(property.CountType)));
+                    const bool is_indices = is_face
+                        && (property.Name == "vertex_indices"
+                            || property.Name == "vertex_index");
+                    if (!is_indices) {
+                        for (UIndex k = 0u; k < count; k++)
+                            reader.Read(property.Type);
+                        continue;
+                    }
+                    if (count < 3u)
+                        throw std::runtime_error("PLY face with fewer than "
+                            "three vertices.");
+                    const auto read_index = [&]() {
+                        const Float64 index = reader.Read(property.Type);
+                        if (!(0.0 <= index && index < 4294967296.0))
+                            throw std::runtime_error("PLY face index out of "
+                                "range.");
+                        return UInt32(index);
+                    };
+                    const UInt32 first = read_index();
+                    UInt32 previous    = read_index();
+                    for (UIndex k = 2u; k < count; k++) {
+                        const UInt32 current = read_index();
+                        mesh.Indices.insert(
+                            mesh.Indices.end(),
+                            { first, previous, current }
+                        );
+                        previous = current;
+                    }
+                }
+                if (is_vertex)
+                    mesh.Vertices.push_back({
+                        Float32(values[coordinates[0]]),
+                        Float32(values[coordinates[1]]),
+                        Float32(values[coordinates[2]])
+                    });
+            }
+        }
+        for (const UInt32 index : mesh.Indices)
+            if (index >= mesh.Vertices.size())
+                throw std::runtime_error("PLY face index out of range.");
+        return mesh;
+    }
+
+    MeshData load_mesh(const std::string& path, ThreadPool* pool) {
+        std::string extension = std::filesystem::path(path).extension()
+            .string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+            [](char c) { return char(std::tolower(c)); });
+        const MappedFile file(path);
+        if (extension == ".obj")
+            return load_obj(file, pool);
+        if (extension == ".ply")
+            return load_ply(file);
+        throw std::runtime_error("Unknown mesh file format " + extension
+            + ".");
+    }
+
+}
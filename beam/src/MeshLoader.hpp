@@ -0,0 +1,20 @@
+#pragma once
+#include "ThreadPool.hpp"
+
+namespace beam {
+
+    struct MeshData {
+        std::vector<Vec3>   Vertices;
+        // Three vertex indices per triangle
+        std::vector<UInt32> Indices;
+    };
+
+    // Loads the triangles of a Wavefront OBJ file or a binary PLY file,
+    // picking the format from the file extension. Polygons with more than
+    // three vertices are split into triangle fans. Everything apart from
+    // vertex positions and faces is ignored. Large OBJ files are parsed in
+    // parallel if a thread pool is given.
+    // Throws std::runtime_error if the file can't be read or is malformed.
+    MeshData load_mesh(const std::string& path, ThreadPool* pool = nullptr);
+
+}
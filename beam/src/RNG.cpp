@@ -14,7 +14,11 @@ namespace beam {
     { }
 
     RNG::RNG(UInt32 seed)
-        : m_gen(seed)
+        : BasicRNG(seed)
     { }
 
+    void RNG::Seed(UInt32 seed) {
+        m_gen = PCG32(seed);
+    }
+
 }
@@ -3,23 +3,91 @@
 
 namespace beam {
 
-    class RNG {
+    // Mixes the bits of a 64 bit value (the SplitMix64 finalizer).
+    inline constexpr UInt64 mix_bits(UInt64 value) {
+        value ^= value >> 30;
+        value *= 0xBF58476D1CE4E5B9u;
+        value ^= value >> 27;
+        value *= 0x94D049BB133111EBu;
+        value ^= value >> 31;
+        return value;
+    }
+
+    // PCG32 (XSH RR), a small and fast generator with 64 bits of state.
+    // See https://www.pcg-random.org for details.
+    class PCG32 {
     public:
-        RNG();
-        RNG(UInt32 seed);
+        using result_type = UInt32;
+
+        constexpr PCG32(UInt64 seed, UInt64 stream = 0u)
+            : m_state(0u)
+            , m_increment((stream << 1u) | 1u)
+        {
+            operator()();
+            m_state += seed;
+            operator()();
+        }
+
+        static constexpr result_type min() { return 0u; }
+        static constexpr result_type max() {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        constexpr result_type operator()() {
+            const UInt64 state = m_state;
+            m_state = state * 6364136223846793005u + m_increment;
+            const UInt32
+                xor_shifted = UInt32(((state >> 18u) ^ state) >> 27u),
+                rotation    = UInt32(state >> 59u);
+            return (xor_shifted >> rotation)
+                | (xor_shifted << ((32u - rotation) & 31u));
+        }
+    private:
+        UInt64 m_state;
+        UInt64 m_increment;
+    };
+
+    template <typename EngineT>
+    class BasicRNG {
+    public:
+        template <typename... Args>
+        explicit BasicRNG(Args&&... args)
+            : m_gen(std::forward<Args>(args)...)
+        { }
 
         template <typename ValueT>
         ValueT Generate(ValueT min, ValueT max) {
             if constexpr (std::is_integral_v<ValueT>)
                 return std::uniform_int_distribution<ValueT>(min, max)(m_gen);
+            else if constexpr (std::is_same_v<ValueT, Float32>)
+                return min + (max - min) * GenerateFloat();
             else if constexpr (std::is_floating_point_v<ValueT>)
-                return std::uniform_real_distribution<ValueT>(min, max)(m_gen);
+                return min + (max - min) * ValueT(GenerateDouble());
             else
                 static_assert(voodoo::False<ValueT>,
                     "Can not generate random value for type.");
         }
-    private:
-        std::default_random_engine m_gen;
+
+        // Returns a uniformly distributed value in [0, 1).
+        inline Float32 GenerateFloat() {
+            return Float32(m_gen() >> 8u) * 0x1.0p-24f;
+        }
+
+        // Returns a uniformly distributed value in [0, 1).
+        inline Float64 GenerateDouble() {
+            const UInt64 bits = (UInt64(m_gen()) << 32u) | m_gen();
+            return Float64(bits >> 11u) * 0x1.0p-53;
+        }
+    protected:
+        EngineT m_gen;
+    };
+
+    class RNG : public BasicRNG<PCG32> {
+    public:
+        RNG();
+        RNG(UInt32 seed);
+
+        void Seed(UInt32 seed);
     };
 
 }
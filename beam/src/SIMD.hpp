@@ -0,0 +1,182 @@
+#pragma once
+
+// Thin wrappers around the SIMD registers of the instruction set the build
+// targets: AVX2 gives 8 lanes, SSE2 gives 4. BEAM_SIMD is left undefined when
+// neither is available or BEAM_NO_SIMD is defined, in which case callers fall
+// back to scalar code.
+#if !defined(BEAM_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BEAM_SIMD 8
+#elif defined(__SSE2__) || defined(_M_X64) \
+        || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BEAM_SIMD 4
+#endif
+#endif
+
+#if defined(BEAM_SIMD)
+
+namespace beam::simd {
+
+    inline constexpr UCount Width = BEAM_SIMD;
+
+    // A comparison result; every lane is either all ones or all zeros
+    struct Mask {
+#if BEAM_SIMD == 8
+        __m256 V;
+
+        inline Mask operator&(Mask other) const {
+            return { _mm256_and_ps(V, other.V) };
+        }
+        inline Mask operator|(Mask other) const {
+            return { _mm256_or_ps(V, other.V) };
+        }
+        // Returns one bit per lane, lane 0 in the lowest bit.
+        inline UInt32 GetBits() const {
+            return UInt32(_mm256_movemask_ps(V));
+        }
+#else
+        __m128 V;
+
+        inline Mask operator&(Mask other) const {
+            return { _mm_and_ps(V, other.V) };
+        }
+        inline Mask operator|(Mask other) const {
+            return { _mm_or_ps(V, other.V) };
+        }
+        inline UInt32 GetBits() const {
+            return UInt32(_mm_movemask_ps(V));
+        }
+#endif
+    };
+
+    struct Float {
+#if BEAM_SIMD == 8
+        __m256 V;
+
+        inline static Float Load(const Float32* src) {
+            return { _mm256_loadu_ps(src) };
+        }
+        inline static Float Broadcast(Float32 value) {
+            return { _mm256_set1_ps(value) };
+        }
+        inline void Store(Float32* dst) const { _mm256_storeu_ps(dst, V); }
+
+        inline Float operator+(Float o) const {
+            return { _mm256_add_ps(V, o.V) };
+        }
+        inline Float operator-(Float o) const {
+            return { _mm256_sub_ps(V, o.V) };
+        }
+        inline Float operator*(Float o) const {
+            return { _mm256_mul_ps(V, o.V) };
+        }
+        inline Float operator/(Float o) const {
+            return { _mm256_div_ps(V, o.V) };
+        }
+
+        inline Mask operator< (Float o) const {
+            return { _mm256_cmp_ps(V, o.V, _CMP_LT_OQ) };
+        }
+        inline Mask operator<=(Float o) const {
+            return { _mm256_cmp_ps(V, o.V, _CMP_LE_OQ) };
+        }
+        inline Mask operator> (Float o) const {
+            return { _mm256_cmp_ps(V, o.V, _CMP_GT_OQ) };
+        }
+        inline Mask operator>=(Float o) const {
+            return { _mm256_cmp_ps(V, o.V, _CMP_GE_OQ) };
+        }
+#else
+        __m128 V;
+
+        inline static Float Load(const Float32* src) {
+            return { _mm_loadu_ps(src) };
+        }
+        inline static Float Broadcast(Float32 value) {
+            return { _mm_set1_ps(value) };
+        }
+        inline void Store(Float32* dst) const { _mm_storeu_ps(dst, V); }
+
+        inline Float operator+(Float o) const { return { _mm_add_ps(V, o.V) }; }
+        inline Float operator-(Float o) const { return { _mm_sub_ps(V, o.V) }; }
+        inline Float operator*(Float o) const { return { _mm_mul_ps(V, o.V) }; }
+        inline Float operator/(Float o) const { return { _mm_div_ps(V, o.V) }; }
+
+        inline Mask operator< (Float o) const {
+            return { _mm_cmplt_ps(V, o.V) };
+        }
+        inline Mask operator<=(Float o) const {
+            return { _mm_cmple_ps(V, o.V) };
+        }
+        inline Mask operator> (Float o) const {
+            return { _mm_cmpgt_ps(V, o.V) };
+        }
+        inline Mask operator>=(Float o) const {
+            return { _mm_cmpge_ps(V, o.V) };
+        }
+#endif
+    };
+
+    struct Vec3 {
+        Float X, Y, Z;
+
+        inline static Vec3 Broadcast(const beam::Vec3& v) {
+            return {
+                Float::Broadcast(v.x),
+                Float::Broadcast(v.y),
+                Float::Broadcast(v.z),
+            };
+        }
+
+        inline Vec3 operator+(const Vec3& o) const {
+            return { X + o.X, Y + o.Y, Z + o.Z };
+        }
+        inline Vec3 operator-(const Vec3& o) const {
+            return { X - o.X, Y - o.Y, Z - o.Z };
+        }
+        inline Vec3 operator*(Float s) const {
+            return { X * s, Y * s, Z * s };
+        }
+    };
+
+    inline Float min(Float a, Float b) {
+#if BEAM_SIMD == 8
+        return { _mm256_min_ps(a.V, b.V) };
+#else
+        return { _mm_min_ps(a.V, b.V) };
+#endif
+    }
+
+    inline Float max(Float a, Float b) {
+#if BEAM_SIMD == 8
+        return { _mm256_max_ps(a.V, b.V) };
+#else
+        return { _mm_max_ps(a.V, b.V) };
+#endif
+    }
+
+    inline Float sqrt(Float a) {
+#if BEAM_SIMD == 8
+        return { _mm256_sqrt_ps(a.V) };
+#else
+        return { _mm_sqrt_ps(a.V) };
+#endif
+    }
+
+    inline Float dot(const Vec3& a, const Vec3& b) {
+        return a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+    }
+
+    inline Vec3 cross(const Vec3& a, const Vec3& b) {
+        return {
+            a.Y * b.Z - a.Z * b.Y,
+            a.Z * b.X - a.X * b.Z,
+            a.X * b.Y - a.Y * b.X,
+        };
+    }
+
+}
+
+#endif
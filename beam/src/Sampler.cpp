@@ -0,0 +1,285 @@
+#include "Common.hpp"
+#include "Sampler.hpp"
+
+namespace beam {
+
+    static constexpr UInt64 golden_ratio = 0x9E3779B97F4A7C15u;
+
+    // Maps the upper 24 bits to a value in [0, 1).
+    static inline Float32 to_unit_float(UInt32 bits) {
+        return Float32(bits >> 8u) * 0x1.0p-24f;
+    }
+
+    // Returns the element at position i of a random permutation of
+    // [0, count) that is picked by the seed, without building the
+    // permutation (Kensler, "Correlated Multi-Jittered Sampling", 2013).
+    static UInt32 permute(UInt32 i, UInt32 count, UInt32 seed) {
+        UInt32 mask = count - 1u;
+        mask |= mask >> 1u;
+        mask |= mask >> 2u;
+        mask |= mask >> 4u;
+        mask |= mask >> 8u;
+        mask |= mask >> 16u;
+        // Permute within the next power of two and walk the cycle until it
+        // leaves the values past the count
+        do {
+            i ^= seed;
+            i *= 0xE170893Du;
+            i ^= seed >> 16u;
+            i ^= (i & mask) >> 4u;
+            i ^= seed >> 8u;
+            i *= 0x0929EB3Fu;
+            i ^= seed >> 23u;
+            i ^= (i & mask) >> 1u;
+            i *= 1u | seed >> 27u;
+            i *= 0x6935FA69u;
+            i ^= (i & mask) >> 11u;
+            i *= 0x74DCB303u;
+            i ^= (i & mask) >> 2u;
+            i *= 0x9E501CC3u;
+            i ^= (i & mask) >> 2u;
+            i *= 0xC860A3DFu;
+            i &= mask;
+            i ^= i >> 5u;
+        } while (i >= count);
+        return (i + seed) % count;
+    }
+
+    // Sampler
+
+    void Sampler::StartSample(UInt32 pixel, UInt32 index,
+            UInt32 dimension) {
+        m_pixel_key = mix_bits((UInt64(m_seed) << 32u) | pixel);
+        m_index     = index;
+        m_dimension = dimension;
+    }
+
+    Float32 Sampler::Get1D() {
+        return Sample1D(m_dimension++);
+    }
+
+    Vec2 Sampler::Get2D() {
+        // Pairs of dimensions start at even dimensions, so that samplers
+        // that stratify them together always see the same pairs
+        m_dimension += m_dimension & 1u;
+        const Vec2 values = Sample2D(m_dimension);
+        m_dimension += 2u;
+        return values;
+    }
+
+    Vec2 Sampler::Sample2D(UInt32 dimension) const {
+        return { Sample1D(dimension), Sample1D(dimension + 1u) };
+    }
+
+    UInt64 Sampler::Hash(UInt64 a, UInt64 b) const {
+        return mix_bits(m_pixel_key ^ mix_bits(a * golden_ratio + b));
+    }
+
+    // IndependentSampler
+
+    std::unique_ptr<Sampler> IndependentSampler::Clone() const {
+        return std::make_unique<IndependentSampler>(*this);
+    }
+
+    Float32 IndependentSampler::Sample1D(UInt32 dimension) const {
+        return to_unit_float(UInt32(Hash(m_index, dimension) >> 32u));
+    }
+
+    // StratifiedSampler
+
+    StratifiedSampler::StratifiedSampler(UInt32 seed,
+            UInt32 samples_per_pixel)
+        : Sampler(seed)
+        , m_samples(std::max(samples_per_pixel, 1u))
+        , m_columns(std::max(UInt32(std::sqrt(Float64(m_samples))), 1u))
+        , m_rows((m_samples + m_columns - 1u) / m_columns)
+    { }
+
+    std::unique_ptr<Sampler> StratifiedSampler::Clone() const {
+        return std::make_unique<StratifiedSampler>(*this);
+    }
+
+    Float32 StratifiedSampler::Sample1D(UInt32 dimension) const {
+        const UInt32 round  = m_index / m_samples;
+        const UInt64 hash   = Hash(round, dimension);
+        const UInt32 stratum =
+            permute(m_index % m_samples, m_samples, UInt32(hash));
+        const Float32 jitter =
+            to_unit_float(UInt32(mix_bits(hash + m_index) >> 32u));
+        return std::min((Float32(stratum) + jitter) / Float32(m_samples),
+            1.0f - std::numeric_limits<Float32>::epsilon());
+    }
+
+    Vec2 StratifiedSampler::Sample2D(UInt32 dimension) const {
+        // The grid may have a few more cells than there are samples, in
+        // which case some cells are left out at random
+        const UInt32 round   = m_index / m_samples;
+        const UInt64 hash    = Hash(round, dimension);
+        const UInt32 stratum =
+            permute(m_index % m_samples, m_columns * m_rows, UInt32(hash));
+        const UInt64 jitter  = mix_bits(hash + m_index);
+        const Vec2 values {
+            (Float32(stratum % m_columns)
+                + to_unit_float(UInt32(jitter))) / Float32(m_columns),
+            (Float32(stratum / m_columns)
+                + to_unit_float(UInt32(jitter >> 32u))) / Float32(m_rows)
+        };
+        return glm::min(values,
+            Vec2(1.0f - std::numeric_limits<Float32>::epsilon()));
+    }
+
+    // SobolSampler
+
+    // The entries of the generator matrices for one bit of the index, in
+    // every dimension
+    using SobolColumn = std::array<UInt32, 4u>;
+
+    // The generator matrices of the first four dimensions of the Sobol
+    // sequence, one column per bit of the index, from the primitive
+    // polynomials and initial direction numbers of Joe and Kuo.
+    static constexpr std::array<SobolColumn, 32u> sobol_columns = [] {
+        struct Polynomial {
+            UInt32 Degree;
+            UInt32 Coefficients;
+            UInt32 Initial[3];
+        };
+        constexpr Polynomial polynomials[3] {
+            { 1u, 0u, { 1u } },
+            { 2u, 1u, { 1u, 3u } },
+            { 3u, 1u, { 1u, 3u, 1u } },
+        };
+        std::array<SobolColumn, 32u> v { };
+        // The first dimension is the van der Corput sequence
+        for (UInt32 bit = 0u; bit < 32u; bit++)
+            v[bit][0] = 1u << (31u - bit);
+        for (UInt32 d = 1u; d < 4u; d++) {
+            const Polynomial& p = polynomials[d - 1u];
+            for (UInt32 bit = 0u; bit < p.Degree; bit++)
+                v[bit][d] = p.Initial[bit] << (31u - bit);
+            for (UInt32 bit = p.Degree; bit < 32u; bit++) {
+                v[bit][d] =
+                    v[bit - p.Degree][d] ^ (v[bit - p.Degree][d] >> p.Degree);
+                for (UInt32 k = 1u; k < p.Degree; k++)
+                    if ((p.Coefficients >> (p.Degree - 1u - k)) & 1u)
+                        v[bit][d] ^= v[bit - k][d];
+            }
+        }
+        return v;
+    }();
+
+    // The products of the generator matrices with every value of each byte
+    // of the index. A point then takes four lookups instead of a step for
+    // every bit of the index, and scrambled indices use all 32 bits.
+    static constexpr std::array<std::array<SobolColumn, 256u>, 4u>
+    sobol_bytes = [] {
+        std::array<std::array<SobolColumn, 256u>, 4u> bytes { };
+        for (UInt32 byte = 0u; byte < 4u; byte++)
+            for (UInt32 value = 0u; value < 256u; value++)
+                for (UInt32 bit = 0u; bit < 8u; bit++)
+                    if ((value >> bit) & 1u)
+                        for (UInt32 d = 0u; d < 4u; d++)
+                            bytes[byte][value][d] ^=
+                                sobol_columns[8u * byte + bit][d];
+        return bytes;
+    }();
+
+    // The first four dimensions of the point with the given index
+    static inline SobolColumn sobol(UInt32 index) {
+        SobolColumn result { };
+        for (UInt32 byte = 0u; byte < 4u; byte++) {
+            const SobolColumn& column =
+                sobol_bytes[byte][(index >> (8u * byte)) & 0xFFu];
+            for (UInt32 d = 0u; d < 4u; d++)
+                result[d] ^= column[d];
+        }
+        return result;
+    }
+
+    static inline UInt32 reverse_bits(UInt32 x) {
+        x = ((x >> 1u) & 0x55555555u) | ((x & 0x55555555u) << 1u);
+        x = ((x >> 2u) & 0x33333333u) | ((x & 0x33333333u) << 2u);
+        x = ((x >> 4u) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4u);
+        x = ((x >> 8u) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8u);
+        return (x >> 16u) | (x << 16u);
+    }
+
+    // Owen scrambling of the bits of x from the highest one down: every
+    // bit is flipped depending on the seed and the bits above it. Hashes
+    // in which every bit only depends on the bits below it do that on the
+    // reversed bits (Laine and Karras, with the constants of Vegdahl).
+    static inline UInt32 owen_scramble(UInt32 x, UInt32 seed) {
+        x  = reverse_bits(x);
+        x ^= x * 0x3D20ADEAu;
+        x += seed;
+        x *= (seed >> 16u) | 1u;
+        x ^= x * 0x05526C56u;
+        x ^= x * 0x53A22864u;
+        return reverse_bits(x);
+    }
+
+    std::unique_ptr<Sampler> SobolSampler::Clone() const {
+        return std::make_unique<SobolSampler>(*this);
+    }
+
+    Float32 SobolSampler::Sample1D(UInt32 dimension) const {
+        const UInt32 group = dimension / 4u;
+        if (group != m_group || m_index != m_group_index
+                || m_pixel_key != m_group_key) {
+            const UInt64 hash = Hash(group);
+            // Scrambling the index shuffles the order of the samples without
+            // breaking up the stratification of its powers of two
+            const SobolColumn point =
+                sobol(owen_scramble(m_index, UInt32(hash)));
+            for (UInt32 d = 0u; d < 4u; d++)
+                m_group_values[d] = to_unit_float(owen_scramble(point[d],
+                    UInt32(mix_bits(hash + 4u * group + d) >> 32u)));
+            m_group_key   = m_pixel_key;
+            m_group_index = m_index;
+            m_group       = group;
+        }
+        return m_group_values[dimension % 4u];
+    }
+
+    // HaltonSampler
+
+    static constexpr UInt32 halton_primes[] {
+          2u,   3u,   5u,   7u,  11u,  13u,  17u,  19u,  23u,  29u,  31u,
+         37u,  41u,  43u,  47u,  53u,  59u,  61u,  67u,  71u,  73u,  79u,
+         83u,  89u,  97u, 101u, 103u, 107u, 109u, 113u, 127u, 131u
+    };
+
+    // The digits of the index in the base in reverse order behind the
+    // point, each one permuted depending on the seed, its level and the
+    // digits of the index before it. Keeps going past the last nonzero
+    // digit until the digits are below the precision of the result, so
+    // that those are scrambled too.
+    static Float32 owen_scrambled_radical_inverse(UInt32 index, UInt32 base,
+            UInt64 seed) {
+        const Float64 inverse_base = 1.0 / Float64(base);
+        UInt64  prefix = 0u;
+        UInt64  digits = 0u;
+        Float64 scale  = 1.0;
+        for (UInt64 level = 0u; scale > 0x1.0p-24; level++) {
+            const UInt32 next  = index / base;
+            const UInt32 digit = index - next * base;
+            const UInt64 hash  = mix_bits(seed ^ (level << 56u) ^ prefix);
+            digits = digits * base + permute(digit, base, UInt32(hash));
+            prefix = prefix * base + digit;
+            scale *= inverse_base;
+            index  = next;
+        }
+        return std::min(Float32(Float64(digits) * scale),
+            1.0f - std::numeric_limits<Float32>::epsilon());
+    }
+
+    std::unique_ptr<Sampler> HaltonSampler::Clone() const {
+        return std::make_unique<HaltonSampler>(*this);
+    }
+
+    Float32 HaltonSampler::Sample1D(UInt32 dimension) const {
+        constexpr UInt32 count = std::size(halton_primes);
+        return owen_scrambled_radical_inverse(m_index,
+            halton_primes[dimension % count], Hash(dimension));
+    }
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "RNG.hpp"
+
+namespace beam {
+
+    // Generates the numbers in [0, 1) that a sample uses for its random
+    // choices, one dimension at a time. Every sample starts with the same
+    // dimensions: two for the position within its pixel and two for the
+    // position on the camera lens, followed by as many as its path needs
+    // for its bounces, which are handed out in order.
+    //
+    // The samplers other than the independent one spread the samples of a
+    // pixel more evenly over every dimension than independent random
+    // numbers would, which lowers the error at the same number of samples.
+    // The numbers only depend on the seed, the pixel, the index of the
+    // sample and the dimension, not on which thread or pass renders the
+    // sample.
+    class Sampler {
+    public:
+        explicit Sampler(UInt32 seed)
+            : m_seed(seed)
+            , m_pixel_key(0u)
+            , m_index(0u)
+            , m_dimension(PathDimension)
+        { }
+        virtual ~Sampler() { }
+
+        // Samplers keep the state of the sample they're generating, so every
+        // sample that is in flight at the same time needs its own copy.
+        virtual std::unique_ptr<Sampler> Clone() const = 0;
+
+        // A sample can be put aside and picked up again later by starting
+        // it at the dimension that GetDimension returned.
+        void StartSample(UInt32 pixel, UInt32 index,
+            UInt32 dimension = PathDimension);
+        inline UInt32 GetDimension() const { return m_dimension; }
+
+        inline Vec2 GetPixel() const { return Sample2D(PixelDimension); }
+        inline Vec2 GetLens()  const { return Sample2D(LensDimension); }
+        // The next dimensions of the path
+        Float32 Get1D();
+        Vec2    Get2D();
+    protected:
+        static constexpr UInt32
+            PixelDimension = 0u,
+            LensDimension  = 2u,
+            PathDimension  = 4u;
+
+        UInt32 m_seed;
+        // A hash of the seed and the pixel of the current sample
+        UInt64 m_pixel_key;
+        UInt32 m_index;
+        UInt32 m_dimension;
+
+        // The value of the current sample in the given dimension.
+        virtual Float32 Sample1D(UInt32 dimension) const = 0;
+        // The values of the current sample in the given dimension and the
+        // one after it, which is always even. Samplers that stratify pairs
+        // of dimensions together override this.
+        virtual Vec2 Sample2D(UInt32 dimension) const;
+
+        // A hash of the seed, the pixel and the given values, for keying
+        // random choices of the sampler.
+        UInt64 Hash(UInt64 a, UInt64 b = 0u) const;
+    };
+
+    // Independent uniform random numbers in every dimension.
+    class IndependentSampler : public Sampler {
+    public:
+        using Sampler::Sampler;
+
+        virtual std::unique_ptr<Sampler> Clone() const override;
+    protected:
+        virtual Float32 Sample1D(UInt32 dimension) const override;
+    };
+
+    // Splits every dimension into as many strata as there are samples per
+    // pixel, and pairs of dimensions into a grid with about as many cells,
+    // and puts each sample in a random, different stratum with a random
+    // offset. Samples past the count start over with another random order
+    // of the strata.
+    class StratifiedSampler : public Sampler {
+    public:
+        StratifiedSampler(UInt32 seed, UInt32 samples_per_pixel);
+
+        virtual std::unique_ptr<Sampler> Clone() const override;
+    protected:
+        virtual Float32 Sample1D(UInt32 dimension) const override;
+        virtual Vec2    Sample2D(UInt32 dimension) const override;
+    private:
+        UInt32 m_samples;
+        UInt32 m_columns;
+        UInt32 m_rows;
+    };
+
+    // The Sobol sequence with Owen scrambling, where the samples of every
+    // pixel are scrambled and shuffled differently (Burley, "Practical
+    // Hash-based Owen Scrambling", 2020). The first four dimensions of the
+    // sequence are used, and later dimensions are padded with independently
+    // scrambled and shuffled copies of them, so every group of four
+    // dimensions is well stratified on its own.
+    class SobolSampler : public Sampler {
+    public:
+        explicit SobolSampler(UInt32 seed)
+            : Sampler(seed)
+            , m_group_key(0u)
+            , m_group_index(0u)
+            , m_group(~0u)
+            , m_group_values()
+        { }
+
+        virtual std::unique_ptr<Sampler> Clone() const override;
+    protected:
+        virtual Float32 Sample1D(UInt32 dimension) const override;
+    private:
+        // The values of the last group of four dimensions that was asked
+        // for, which are computed together since they share the scrambled
+        // index, along with the pixel key and the index they belong to.
+        mutable UInt64                  m_group_key;
+        mutable UInt32                  m_group_index;
+        mutable UInt32                  m_group;
+        mutable std::array<Float32, 4u> m_group_values;
+    };
+
+    // The Halton sequence, with its digits scrambled in a nested random
+    // order that differs for every pixel and dimension (Owen scrambling).
+    // Uses a prime base per dimension, and starts over at base two with a
+    // different scramble past the last prime.
+    class HaltonSampler : public Sampler {
+    public:
+        using Sampler::Sampler;
+
+        virtual std::unique_ptr<Sampler> Clone() const override;
+    protected:
+        virtual Float32 Sample1D(UInt32 dimension) const override;
+    };
+
+}
@@ -0,0 +1,285 @@
+#include "Common.hpp"
+#include "SceneCache.hpp"
+#include "MappedFile.hpp"
+
+namespace beam {
+
+    static constexpr char  scene_cache_magic[4] = { 'B', 'E', 'A', 'M' };
+    static constexpr USize scene_cache_alignment = 16u;
+
+    // Materials are stored with a fixed layout independent of the padding
+    // of Material.
+    struct CachedMaterial {
+        UInt32  Type;
+        Float32 R, G, B, A;
+        Float32 Emission;
+    };
+
+    static_assert(sizeof(SceneCacheHeader) == 32u);
+    static_assert(sizeof(CachedMaterial) == 24u);
+    static_assert(sizeof(SceneCacheInstance) == 68u);
+    static_assert(sizeof(Mat4) == 16u * sizeof(Float32));
+    static_assert(sizeof(Vec3) == 3u * sizeof(Float32));
+
+    static CachedMaterial to_cached(const Material& material) {
+        return {
+            UInt32(material.Type),
+            material.Color.r,
+            material.Color.g,
+            material.Color.b,
+            material.Color.a,
+            material.Emission
+        };
+    }
+
+    static Material from_cached(const CachedMaterial& material) {
+        return Material(
+            MaterialType(material.Type),
+            Color(material.R, material.G, material.B, material.A),
+            material.Emission
+        );
+    }
+
+    class CacheWriter {
+    public:
+        CacheWriter(std::ofstream& file) : m_file(file), m_offset(0u) { }
+
+        template <typename T>
+        void Write(const T* data, UCount count) {
+            Pad();
+            const USize size = count * sizeof(T);
+            m_file.write(reinterpret_cast<const char*>(data), size);
+            m_offset += size;
+        }
+
+        template <typename T>
+        void Write(const std::vector<T>& values) {
+            Write(values.data(), values.size());
+        }
+
+        void Write(const Material& material) {
+            const CachedMaterial cached = to_cached(material);
+            Write(&cached, 1u);
+        }
+
+        void Write(const std::vector<Material>& materials) {
+            std::vector<CachedMaterial> cached;
+            cached.reserve(materials.size());
+            for (const Material& material : materials)
+                cached.push_back(to_cached(material));
+            Write(cached);
+        }
+    private:
+        void Pad() {
+            static constexpr char zeros[scene_cache_alignment] = { };
+            const USize padding = (scene_cache_alignment
+                - m_offset % scene_cache_alignment) % scene_cache_alignment;
+            m_file.write(zeros, padding);
+            m_offset += padding;
+        }
+
+        std::ofstream& m_file;
+        USize          m_offset;
+    };
+
+    // Reads the arrays out of a mapped cache file, checking that they are
+    // within its bounds.
+    class CacheReader {
+    public:
+        CacheReader(const MappedFile& file) : m_file(file), m_offset(0u) { }
+
+        template <typename T>
+        const T* Read(UCount count) {
+            m_offset += (scene_cache_alignment
+                - m_offset % scene_cache_alignment) % scene_cache_alignment;
+            const USize size = count * sizeof(T);
+            if (m_offset > m_file.GetSize()
+                    || size > m_file.GetSize() - m_offset)
+                throw std::runtime_error("Scene cache file is truncated.");
+            const Byte* data = m_file.GetData() + m_offset;
+            m_offset += size;
+            return reinterpret_cast<const T*>(data);
+        }
+
+        template <typename T>
+        void Read(std::vector<T>& values, UCount count) {
+            const T* data = Read<T>(count);
+            values.assign(data, data + count);
+        }
+
+        void Read(std::vector<Material>& materials, UCount count) {
+            const CachedMaterial* data = Read<CachedMaterial>(count);
+            materials.clear();
+            materials.reserve(count);
+            for (UIndex i = 0u; i < count; i++)
+                materials.push_back(from_cached(data[i]));
+        }
+    private:
+        const MappedFile& m_file;
+        USize             m_offset;
+    };
+
+    bool save_scene_cache(const Scene& scene, const std::string& path) {
+        if (scene.GetObjectCount() > 0u)
+            std::cerr << "Scene cache files only store spheres, planes, "
+                "triangles and meshes; " << scene.GetObjectCount()
+                << " other objects are left out." << std::endl;
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Can't open " << path << " for writing."
+                << std::endl;
+            return false;
+        }
+
+        const SphereArray&   spheres   = scene.GetSpheres();
+        const PlaneArray&    planes    = scene.GetPlanes();
+        const TriangleArray& triangles = scene.GetTriangles();
+
+        SceneCacheHeader header = { };
+        std::copy(
+            std::begin(scene_cache_magic),
+            std::end(scene_cache_magic),
+            header.Magic
+        );
+        header.Version       = scene_cache_version;
+        header.SphereCount   = UInt32(spheres.GetCount());
+        header.PlaneCount    = UInt32(planes.GetCount());
+        header.TriangleCount = UInt32(triangles.GetCount());
+        header.MeshCount     = UInt32(scene.GetMeshes().size());
+        header.InstanceCount = UInt32(scene.GetInstances().size());
+
+        CacheWriter writer(file);
+        writer.Write(&header, 1u);
+
+        writer.Write(spheres.CenterX);
+        writer.Write(spheres.CenterY);
+        writer.Write(spheres.CenterZ);
+        writer.Write(spheres.Radius);
+        writer.Write(spheres.Materials);
+
+        writer.Write(planes.NormalX);
+        writer.Write(planes.NormalY);
+        writer.Write(planes.NormalZ);
+        writer.Write(planes.D);
+        writer.Write(planes.Materials);
+
+        writer.Write(triangles.AX);
+        writer.Write(triangles.AY);
+        writer.Write(triangles.AZ);
+        writer.Write(triangles.ABX);
+        writer.Write(triangles.ABY);
+        writer.Write(triangles.ABZ);
+        writer.Write(triangles.ACX);
+        writer.Write(triangles.ACY);
+        writer.Write(triangles.ACZ);
+        writer.Write(triangles.Normals);
+        writer.Write(triangles.Materials);
+
+        for (const Mesh& mesh : scene.GetMeshes()) {
+            const SceneCacheMesh mesh_header = {
+                UInt32(mesh.GetVertices().size()),
+                UInt32(mesh.GetIndices().size())
+            };
+            writer.Write(&mesh_header, 1u);
+            writer.Write(mesh.Material);
+            writer.Write(mesh.GetVertices());
+            writer.Write(mesh.GetIndices());
+        }
+
+        std::vector<SceneCacheInstance> instances;
+        instances.reserve(scene.GetInstances().size());
+        for (const Instance& instance : scene.GetInstances()) {
+            SceneCacheInstance cached;
+            cached.Mesh = instance.MeshID;
+            std::memcpy(cached.Transform, &instance.GetTransform(),
+                sizeof(cached.Transform));
+            instances.push_back(cached);
+        }
+        writer.Write(instances);
+
+        if (!file.good()) {
+            std::cerr << "Can't write to " << path << "." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool load_scene_cache(Scene& scene, const std::string& path,
+            ThreadPool* pool) {
+        scene.Clear();
+
+        try {
+            const MappedFile file(path);
+            CacheReader reader(file);
+
+            const SceneCacheHeader& header = *reader.Read<SceneCacheHeader>(1u);
+            if (!std::equal(
+                    std::begin(scene_cache_magic),
+                    std::end(scene_cache_magic),
+                    header.Magic))
+                throw std::runtime_error("Not a scene cache file.");
+            if (header.Version != scene_cache_version)
+                throw std::runtime_error("Unsupported scene cache version.");
+
+            SphereArray& spheres = scene.GetSpheres();
+            reader.Read(spheres.CenterX,   header.SphereCount);
+            reader.Read(spheres.CenterY,   header.SphereCount);
+            reader.Read(spheres.CenterZ,   header.SphereCount);
+            reader.Read(spheres.Radius,    header.SphereCount);
+            reader.Read(spheres.Materials, header.SphereCount);
+
+            PlaneArray& planes = scene.GetPlanes();
+            reader.Read(planes.NormalX,   header.PlaneCount);
+            reader.Read(planes.NormalY,   header.PlaneCount);
+            reader.Read(planes.NormalZ,   header.PlaneCount);
+            reader.Read(planes.D,         header.PlaneCount);
+            reader.Read(planes.Materials, header.PlaneCount);
+
+            TriangleArray& triangles = scene.GetTriangles();
+            reader.Read(triangles.AX,        header.TriangleCount);
+            reader.Read(triangles.AY,        header.TriangleCount);
+            reader.Read(triangles.AZ,        header.TriangleCount);
+            reader.Read(triangles.ABX,       header.TriangleCount);
+            reader.Read(triangles.ABY,       header.TriangleCount);
+            reader.Read(triangles.ABZ,       header.TriangleCount);
+            reader.Read(triangles.ACX,       header.TriangleCount);
+            reader.Read(triangles.ACY,       header.TriangleCount);
+            reader.Read(triangles.ACZ,       header.TriangleCount);
+            reader.Read(triangles.Normals,   header.TriangleCount);
+            reader.Read(triangles.Materials, header.TriangleCount);
+
+            for (UIndex i = 0u; i < header.MeshCount; i++) {
+                const SceneCacheMesh& mesh = *reader.Read<SceneCacheMesh>(1u);
+                const Material material =
+                    from_cached(*reader.Read<CachedMaterial>(1u));
+                std::vector<Vec3>   vertices;
+                std::vector<UInt32> indices;
+                reader.Read(vertices, mesh.VertexCount);
+                reader.Read(indices,  mesh.IndexCount);
+                scene.AddMesh(material, std::move(vertices),
+                    std::move(indices), pool);
+            }
+
+            const SceneCacheInstance* instances =
+                reader.Read<SceneCacheInstance>(header.InstanceCount);
+            for (UIndex i = 0u; i < header.InstanceCount; i++) {
+                if (instances[i].Mesh >= header.MeshCount)
+                    throw std::runtime_error(
+                        "Scene cache instance refers to a missing mesh.");
+                Mat4 transform;
+                std::memcpy(&transform, instances[i].Transform,
+                    sizeof(instances[i].Transform));
+                scene.AddInstance(instances[i].Mesh, transform);
+            }
+        } catch (const std::exception& exc) {
+            std::cerr << exc.what() << std::endl;
+            scene.Clear();
+            return false;
+        }
+
+        scene.Build(pool);
+        return true;
+    }
+
+}
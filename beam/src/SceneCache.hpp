@@ -0,0 +1,46 @@
+#pragma once
+#include "raytracing/Scene.hpp"
+
+namespace beam {
+
+    // A compact binary scene format (.beamb) that stores the primitive
+    // arrays of a scene as they are laid out in memory, so loading it is a
+    // few bulk copies out of the mapped file instead of parsing text and
+    // adding objects one by one.
+    //
+    // The file starts with a SceneCacheHeader, followed by the arrays of the
+    // spheres, planes and triangles in the order of their fields, and then
+    // every mesh as a SceneCacheMesh followed by its vertices and indices,
+    // and finally the SceneCacheInstance records of the mesh instances.
+    // Every array starts at a multiple of 16 bytes. All values are little
+    // endian.
+
+    constexpr UInt32 scene_cache_version = 3u;
+
+    struct SceneCacheHeader {
+        char   Magic[4];
+        UInt32 Version;
+        UInt32 SphereCount;
+        UInt32 PlaneCount;
+        UInt32 TriangleCount;
+        UInt32 MeshCount;
+        UInt32 InstanceCount;
+        UInt32 Reserved;
+    };
+
+    struct SceneCacheMesh {
+        UInt32 VertexCount;
+        UInt32 IndexCount;
+    };
+
+    struct SceneCacheInstance {
+        UInt32  Mesh;
+        // The column major transform of the instance
+        Float32 Transform[16];
+    };
+
+    bool save_scene_cache(const Scene& scene, const std::string& path);
+    bool load_scene_cache(Scene& scene, const std::string& path,
+        ThreadPool* pool = nullptr);
+
+}
@@ -2,6 +2,8 @@
 #include "SceneParser.hpp"
 #include <nlohmann/json.hpp>
 #include "rendering/Color.hpp"
+#include "SceneCache.hpp"
+#include "MeshLoader.hpp"
 
 using json = nlohmann::json;
 
@@ -38,13 +40,42 @@ namespace beam {
         );
     }
 
+    // Builds an instance transform from an optional translation, rotation
+    // in degrees around the x, y and z axes (applied in that order) and
+    // scale.
+    static Mat4 parse_transform(const json& src) {
+        Mat4 transform(1.0f);
+        if (src.contains("translation"))
+            transform = glm::translate(transform,
+                parse_vec3(src["translation"]));
+        if (src.contains("rotation")) {
+            const Vec3 angles = glm::radians(parse_vec3(src["rotation"]));
+            const Vec3 x(1.0f, 0.0f, 0.0f), y(0.0f, 1.0f, 0.0f),
+                z(0.0f, 0.0f, 1.0f);
+            transform = glm::rotate(transform, angles.z, z);
+            transform = glm::rotate(transform, angles.y, y);
+            transform = glm::rotate(transform, angles.x, x);
+        }
+        if (src.contains("scale")) {
+            const json& scale = src["scale"];
+            transform = glm::scale(transform, scale.is_number()
+                ? Vec3(Float32(scale))
+                : parse_vec3(scale));
+        }
+        return transform;
+    }
+
     static const json& get_key(const json& src, const std::string& key) {
         if (src.contains(key))
             return src[key];
         throw std::runtime_error("Key not present.");
     }
 
-    bool parse_scene(Scene& scene, const std::string& path) {
+    bool parse_scene(Scene& scene, const std::string& path,
+            ThreadPool* pool) {
+        if (std::filesystem::path(path).extension() == ".beamb")
+            return load_scene_cache(scene, path, pool);
+
         scene.Clear();
 
         std::ifstream file(path);
@@ -86,8 +117,29 @@ namespace beam {
                         parse_vec3(get_key(obj, "b")),
                         parse_vec3(get_key(obj, "c"))
                     );
+                } else if (get_key(obj, "type") == "mesh") {
+                    // Mesh files are found relative to the scene file
+                    const std::filesystem::path mesh_path =
+                        std::filesystem::path(path).parent_path()
+                        / std::string(get_key(obj, "file"));
+                    MeshData mesh = load_mesh(mesh_path.string(), pool);
+                    const UIndex mesh_index = scene.AddMesh(
+                        parse_material(get_key(obj, "material")),
+                        std::move(mesh.Vertices),
+                        std::move(mesh.Indices),
+                        pool
+                    );
+                    // The mesh is loaded once and placed at every instance
+                    if (obj.contains("instances")) {
+                        for (const auto& instance : obj["instances"])
+                            scene.AddInstance(mesh_index,
+                                parse_transform(instance));
+                    } else {
+                        scene.AddInstance(mesh_index, Mat4(1.0f));
+                    }
                 } else {
                     std::cerr << "Unknown object type." << std::endl;
+                    scene.Build(pool);
                     return false;
                 }
             }
@@ -97,6 +149,7 @@ namespace beam {
             return false;
         }
 
+        scene.Build(pool);
         return true;
     }
 
@@ -1,8 +1,12 @@
 #pragma once
-#include "raytracing/Objects.hpp"
+#include "raytracing/Scene.hpp"
 
 namespace beam {
 
-    bool parse_scene(Scene& scene, const std::string& path);
+    // Loads a JSON scene file, or a scene cache file if the path ends in
+    // .beamb. Mesh files are parsed and acceleration structures are built
+    // in parallel if a thread pool is given.
+    bool parse_scene(Scene& scene, const std::string& path,
+        ThreadPool* pool = nullptr);
 
 }
@@ -0,0 +1,79 @@
+#include "Common.hpp"
+#include "ThreadPool.hpp"
+
+namespace beam {
+
+    ThreadPool::ThreadPool()
+        : ThreadPool(std::max(1u, std::thread::hardware_concurrency()))
+    { }
+
+    ThreadPool::ThreadPool(UCount thread_count)
+        : m_task(nullptr)
+        , m_task_count(0u)
+        , m_next_task(0u)
+        , m_active_workers(0u)
+        , m_generation(0u)
+        , m_stopping(false)
+    {
+        for (UIndex thread = 1u; thread < thread_count; thread++)
+            m_workers.emplace_back(&ThreadPool::RunWorker, this, thread);
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_work_cv.notify_all();
+        for (auto& worker : m_workers)
+            worker.join();
+    }
+
+    void ThreadPool::ParallelFor(UCount count, const Task& task) {
+        if (count == 0u)
+            return;
+        if (m_workers.empty()) {
+            for (UIndex i = 0u; i < count; i++)
+                task(i, 0u);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task           = &task;
+            m_task_count     = count;
+            m_next_task      = 0u;
+            m_active_workers = m_workers.size();
+            m_generation++;
+        }
+        m_work_cv.notify_all();
+        RunTasks(0u);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done_cv.wait(lock, [this] { return m_active_workers == 0u; });
+        m_task = nullptr;
+    }
+
+    void ThreadPool::RunWorker(UIndex thread) {
+        UInt64 generation = 0u;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_work_cv.wait(lock, [&] {
+                    return m_stopping || m_generation != generation;
+                });
+                if (m_stopping)
+                    return;
+                generation = m_generation;
+            }
+            RunTasks(thread);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_active_workers == 0u)
+                m_done_cv.notify_one();
+        }
+    }
+
+    void ThreadPool::RunTasks(UIndex thread) {
+        for (UIndex i = m_next_task++; i < m_task_count; i = m_next_task++)
+            (*m_task)(i, thread);
+    }
+
+}
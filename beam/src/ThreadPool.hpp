@@ -0,0 +1,44 @@
+#pragma once
+
+namespace beam {
+
+    // A fixed set of worker threads that stay alive for the lifetime of the
+    // pool, so that parallel work doesn't pay for thread creation every time.
+    class ThreadPool {
+    public:
+        using Task = std::function<void(UIndex index, UIndex thread)>;
+
+        // Creates a pool that uses all available hardware threads.
+        ThreadPool();
+        // Creates a pool that uses thread_count threads, including the
+        // thread that calls ParallelFor.
+        ThreadPool(UCount thread_count);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&)            = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        inline UCount GetThreadCount() const { return m_workers.size() + 1u; }
+
+        // Calls task(index, thread) for every index in [0, count) and blocks
+        // until all of them are done. The calling thread takes part in the
+        // work as thread 0; the thread index is always less than
+        // GetThreadCount(). Must not be called from within a task.
+        void ParallelFor(UCount count, const Task& task);
+    private:
+        std::vector<std::thread> m_workers;
+        std::mutex               m_mutex;
+        std::condition_variable  m_work_cv;
+        std::condition_variable  m_done_cv;
+        const Task*              m_task;
+        UCount                   m_task_count;
+        std::atomic<UIndex>      m_next_task;
+        UCount                   m_active_workers;
+        UInt64                   m_generation;
+        bool                     m_stopping;
+
+        void RunWorker(UIndex thread);
+        void RunTasks(UIndex thread);
+    };
+
+}
@@ -0,0 +1,89 @@
+#include "Common.hpp"
+#include "AABB.hpp"
+
+namespace beam {
+
+    AABB AABB::GetBoundingBox() const {
+        return *this;
+    }
+
+    bool AABB::Intersect(const Ray&, Hit&) const {
+        return false;
+    }
+
+    Intersection AABB::GetIntersection(const Ray&, const Hit&) const {
+        return Intersection();
+    }
+
+    bool AABB::Intersects(const Ray& ray, Float32 t_max) const {
+        return IntersectDistance(ray) < t_max;
+    }
+
+    Float32 AABB::IntersectDistance(const Ray& ray) const {
+        const Vec3 inv_dir = 1.0f / ray.Direction;
+        const Float32
+            t_0   = inv_dir.x * (XMin - ray.Origin.x),
+            t_1   = inv_dir.x * (XMax - ray.Origin.x),
+            t_2   = inv_dir.y * (YMin - ray.Origin.y),
+            t_3   = inv_dir.y * (YMax - ray.Origin.y),
+            t_4   = inv_dir.z * (ZMin - ray.Origin.z),
+            t_5   = inv_dir.z * (ZMax - ray.Origin.z),
+            t_min = std::max(
+                        std::max(std::min(t_0, t_1), std::min(t_2, t_3)),
+                        std::min(t_4, t_5)
+                    ),
+            t_max = std::min(
+                        std::min(std::max(t_0, t_1), std::max(t_2, t_3)),
+                        std::max(t_4, t_5)
+                    );
+        if (t_max >= 0.0f && t_max >= t_min)
+            return std::max(t_min, 0.0f);
+        return std::numeric_limits<Float32>::infinity();
+    }
+
+    void AABB::Combine(const AABB& aabb) {
+        XMin = std::min(XMin, aabb.XMin);
+        XMax = std::max(XMax, aabb.XMax);
+        YMin = std::min(YMin, aabb.YMin);
+        YMax = std::max(YMax, aabb.YMax);
+        ZMin = std::min(ZMin, aabb.ZMin);
+        ZMax = std::max(ZMax, aabb.ZMax);
+    }
+
+    void AABB::Combine(const Vec3& point) {
+        XMin = std::min(XMin, point.x);
+        XMax = std::max(XMax, point.x);
+        YMin = std::min(YMin, point.y);
+        YMax = std::max(YMax, point.y);
+        ZMin = std::min(ZMin, point.z);
+        ZMax = std::max(ZMax, point.z);
+    }
+
+    Float32 AABB::GetSurfaceArea() const {
+        if (XMin > XMax || YMin > YMax || ZMin > ZMax)
+            return 0.0f;
+        const Float32
+            dx = XMax - XMin,
+            dy = YMax - YMin,
+            dz = ZMax - ZMin;
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+
+    bool AABB::IsFinite() const {
+        return std::isfinite(XMin) && std::isfinite(XMax)
+            && std::isfinite(YMin) && std::isfinite(YMax)
+            && std::isfinite(ZMin) && std::isfinite(ZMax);
+    }
+
+    AABB AABB::OverarchingAABB(const AABB& a, const AABB& b) {
+        return AABB(
+            std::min(a.XMin, b.XMin),
+            std::max(a.XMax, b.XMax),
+            std::min(a.YMin, b.YMin),
+            std::max(a.YMax, b.YMax),
+            std::min(a.ZMin, b.ZMin),
+            std::max(a.ZMax, b.ZMax)
+        );
+    }
+
+}
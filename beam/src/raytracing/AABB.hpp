@@ -0,0 +1,61 @@
+#pragma once
+#include "raytracing/Raytracing.hpp"
+
+namespace beam {
+
+    class AABB : public Intersectable {
+    public:
+        Float32 XMin, XMax, YMin, YMax, ZMin, ZMax;
+
+        AABB()
+            : XMin(-std::numeric_limits<Float32>::infinity())
+            , XMax( std::numeric_limits<Float32>::infinity())
+            , YMin(-std::numeric_limits<Float32>::infinity())
+            , YMax( std::numeric_limits<Float32>::infinity())
+            , ZMin(-std::numeric_limits<Float32>::infinity())
+            , ZMax( std::numeric_limits<Float32>::infinity())
+        { }
+        AABB(Float32 x_min, Float32 x_max, Float32 y_min, Float32 y_max,
+                Float32 z_min, Float32 z_max)
+            : XMin(x_min), XMax(x_max), YMin(y_min), YMax(y_max), ZMin(z_min),
+                ZMax(z_max) { }
+
+        virtual AABB GetBoundingBox() const override;
+        using Intersectable::Intersect;
+        virtual bool Intersect(const Ray& ray, Hit& hit) const override;
+        virtual Intersection GetIntersection(const Ray& ray, const Hit& hit)
+            const override;
+        using Intersectable::Intersects;
+        virtual bool Intersects(const Ray& ray, Float32 t_max) const override;
+
+        // Returns the distance along the ray at which it enters the box, or
+        // infinity if the ray misses it.
+        Float32 IntersectDistance(const Ray& ray) const;
+
+        void Combine(const AABB& aabb);
+        void Combine(const Vec3& point);
+
+        inline Vec3 GetMin()    const { return { XMin, YMin, ZMin }; }
+        inline Vec3 GetMax()    const { return { XMax, YMax, ZMax }; }
+        inline Vec3 GetCenter() const { return 0.5f * (GetMin() + GetMax()); }
+
+        // Returns the surface area of the box, or zero if it's empty.
+        Float32 GetSurfaceArea() const;
+        bool IsFinite() const;
+
+        static AABB OverarchingAABB(const AABB& a, const AABB& b);
+
+        inline static AABB Infinite() { return AABB(); }
+        inline static AABB Nothing() {
+            return AABB(
+                 std::numeric_limits<Float32>::infinity(),
+                -std::numeric_limits<Float32>::infinity(),
+                 std::numeric_limits<Float32>::infinity(),
+                -std::numeric_limits<Float32>::infinity(),
+                 std::numeric_limits<Float32>::infinity(),
+                -std::numeric_limits<Float32>::infinity()
+            );
+        }
+    };
+
+}
@@ -0,0 +1,634 @@
+#include "Common.hpp"
+#include "BVH.hpp"
+
+namespace beam {
+
+    static constexpr UCount
+        MaxBinCount = 16u,
+        MaxLeafSize = 8u;
+
+    // Relative costs of visiting a node and of testing a primitive
+    static constexpr Float32
+        TraversalCost    = 1.0f,
+        IntersectionCost = 1.0f;
+
+    // Nodes with at least this many primitives are binned and measured by
+    // all threads together while the top of the tree is built.
+    static constexpr UCount
+        ParallelNodeSize    = 1u << 16u,
+    // The top of the tree is split until the subtrees are no larger than
+    // the number of primitives divided by this times the thread count.
+        SubtreesPerThread   = 8u,
+        MinParallelSubtree  = 1u << 12u;
+
+    // A light bounding box without the interface of AABB, so that the hot
+    // loops of the build can be inlined
+    struct Box {
+        Vec3 Min, Max;
+
+        static inline Box Nothing() {
+            constexpr Float32 inf = std::numeric_limits<Float32>::infinity();
+            return { Vec3(inf), Vec3(-inf) };
+        }
+
+        inline void Combine(const Box& box) {
+            Min = glm::min(Min, box.Min);
+            Max = glm::max(Max, box.Max);
+        }
+
+        inline void Combine(const Vec3& point) {
+            Min = glm::min(Min, point);
+            Max = glm::max(Max, point);
+        }
+
+        inline Float32 GetSurfaceArea() const {
+            if (Min.x > Max.x || Min.y > Max.y || Min.z > Max.z)
+                return 0.0f;
+            const Vec3 d = Max - Min;
+            return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+
+        inline AABB ToAABB() const {
+            return AABB(Min.x, Max.x, Min.y, Max.y, Min.z, Max.z);
+        }
+    };
+
+    // The primitives are partitioned as a whole rather than through their
+    // indices, so that every pass over a node reads contiguous memory.
+    struct Primitive {
+        Box    Bounds;
+        UInt32 Index;
+
+        inline Vec3 GetCenter() const {
+            return 0.5f * (Bounds.Min + Bounds.Max);
+        }
+    };
+
+    struct BuildState {
+        std::vector<Primitive> Primitives;
+        // Only set while the top of the tree is built
+        ThreadPool*            Pool;
+    };
+
+    // For loops that don't produce a result
+    struct Empty {
+        inline void Combine(const Empty&) { }
+    };
+
+    // The bounds of a node and of the centers of its primitives
+    struct NodeBounds {
+        Box Bounds  = Box::Nothing();
+        Box Centers = Box::Nothing();
+
+        inline void Combine(const NodeBounds& bounds) {
+            Bounds.Combine(bounds.Bounds);
+            Centers.Combine(bounds.Centers);
+        }
+    };
+
+    // The bounds and counts of the primitives whose centers fall into each
+    // bin, for every axis. Small nodes use fewer bins, which saves most of
+    // the fixed cost of evaluating splits near the leaves.
+    struct Bins {
+        UCount                                          Count;
+        std::array<std::array<Box,    MaxBinCount>, 3u> Bounds;
+        std::array<std::array<UCount, MaxBinCount>, 3u> Counts;
+
+        Bins(UCount count = MaxBinCount) : Count(count) {
+            for (UIndex axis = 0u; axis < 3u; axis++) {
+                std::fill_n(Bounds[axis].begin(), count, Box::Nothing());
+                std::fill_n(Counts[axis].begin(), count, UCount(0u));
+            }
+        }
+
+        inline void Combine(const Bins& bins) {
+            for (UIndex axis = 0u; axis < 3u; axis++) {
+                for (UIndex bin = 0u; bin < Count; bin++) {
+                    Bounds[axis][bin].Combine(bins.Bounds[axis][bin]);
+                    Counts[axis][bin] += bins.Counts[axis][bin];
+                }
+            }
+        }
+    };
+
+    struct Split {
+        UIndex  Axis;
+        // Primitives in bins up to and including this one go to the left
+        UIndex  Bin;
+        UCount  BinCount;
+        Float32 Cost;
+    };
+
+    static inline UCount get_bin_count(UCount primitive_count) {
+        return std::clamp(primitive_count, UCount(4u), MaxBinCount);
+    }
+
+    static inline UIndex get_bin(Float32 center, Float32 min, Float32 scale,
+            UCount bin_count) {
+        return UIndex(std::min(
+            Int32(bin_count) - 1,
+            Int32((center - min) * scale)
+        ));
+    }
+
+    // Calls func(begin, end, result) for parts of [first, first + count),
+    // spread over the threads of the pool if there is one, and returns the
+    // combination of the results of all parts.
+    template <typename ResultT, typename Func>
+    static ResultT for_parts(ThreadPool* pool, UInt32 first, UInt32 count,
+            const ResultT& initial, Func&& func) {
+        if (!pool) {
+            ResultT result = initial;
+            func(first, first + count, result);
+            return result;
+        }
+        const UCount part_count = pool->GetThreadCount();
+        std::vector<ResultT> results(part_count, initial);
+        pool->ParallelFor(part_count, [&](UIndex part, UIndex) {
+            const UInt32
+                begin = first + UInt32(count * part / part_count),
+                end   = first + UInt32(count * (part + 1u) / part_count);
+            func(begin, end, results[part]);
+        });
+        for (UIndex part = 1u; part < part_count; part++)
+            results[0].Combine(results[part]);
+        return results[0];
+    }
+
+    static NodeBounds get_bounds(const BuildState& state, UInt32 first,
+            UInt32 count) {
+        ThreadPool* pool = count >= ParallelNodeSize ? state.Pool : nullptr;
+        return for_parts(pool, first, count, NodeBounds(),
+            [&](UInt32 begin, UInt32 end, NodeBounds& bounds) {
+                for (UInt32 i = begin; i < end; i++) {
+                    const Primitive& primitive = state.Primitives[i];
+                    bounds.Bounds.Combine(primitive.Bounds);
+                    bounds.Centers.Combine(primitive.GetCenter());
+                }
+            });
+    }
+
+    static std::optional<Split> find_split(const BuildState& state,
+            UInt32 first, UInt32 count, const NodeBounds& bounds) {
+        const UCount bin_count = get_bin_count(count);
+        const Vec3
+            min    = bounds.Centers.Min,
+            extent = bounds.Centers.Max - min;
+        Vec3 scale;
+        for (UIndex axis = 0u; axis < 3u; axis++)
+            scale[axis] = extent[axis] > 0.0f
+                ? Float32(bin_count) / extent[axis]
+                : 0.0f;
+
+        ThreadPool* pool = count >= ParallelNodeSize ? state.Pool : nullptr;
+        const Bins bins = for_parts(pool, first, count, Bins(bin_count),
+            [&](UInt32 begin, UInt32 end, Bins& bins) {
+                for (UInt32 i = begin; i < end; i++) {
+                    const Primitive& primitive = state.Primitives[i];
+                    const Vec3       center    = primitive.GetCenter();
+                    for (UIndex axis = 0u; axis < 3u; axis++) {
+                        const UIndex bin = get_bin(center[axis], min[axis],
+                            scale[axis], bin_count);
+                        bins.Bounds[axis][bin].Combine(primitive.Bounds);
+                        bins.Counts[axis][bin]++;
+                    }
+                }
+            });
+
+        std::optional<Split> best = std::nullopt;
+        const Float32 inv_area = 1.0f / bounds.Bounds.GetSurfaceArea();
+        for (UIndex axis = 0u; axis < 3u; axis++) {
+            if (!(extent[axis] > 0.0f))
+                continue;
+            const auto& bin_bounds = bins.Bounds[axis];
+            const auto& bin_counts = bins.Counts[axis];
+            // Sweep from the right to get the cost of every right half,
+            // then from the left to evaluate each split plane.
+            std::array<Float32, MaxBinCount> right_costs;
+            Box    right_bounds = Box::Nothing();
+            UCount right_count  = 0u;
+            for (UIndex bin = bin_count - 1u; bin > 0u; bin--) {
+                right_bounds.Combine(bin_bounds[bin]);
+                right_count += bin_counts[bin];
+                right_costs[bin] =
+                    Float32(right_count) * right_bounds.GetSurfaceArea();
+            }
+            Box    left_bounds = Box::Nothing();
+            UCount left_count  = 0u;
+            for (UIndex bin = 0u; bin < bin_count - 1u; bin++) {
+                left_bounds.Combine(bin_bounds[bin]);
+                left_count += bin_counts[bin];
+                if (left_count == 0u || left_count == count)
+                    continue;
+                const Float32 cost = TraversalCost + IntersectionCost
+                    * inv_area * (
+                        Float32(left_count) * left_bounds.GetSurfaceArea()
+                        + right_costs[bin + 1u]
+                    );
+                if (!best || cost < best->Cost)
+                    best = Split { axis, bin, bin_count, cost };
+            }
+        }
+        return best;
+    }
+
+    struct Partition {
+        // The position of the first primitive of the second half
+        UInt32     Middle;
+        NodeBounds Left, Right;
+    };
+
+    // Decides how to split the primitives in [first, first + count), which
+    // have the given bounds, and partitions them accordingly. Returns the
+    // halves, measured along the way so that the children don't need
+    // another pass over their primitives, or nothing if the primitives
+    // should form a leaf.
+    static std::optional<Partition> partition(BuildState& state,
+            UInt32 first, UInt32 count, UCount depth,
+            const NodeBounds& bounds) {
+        if (count == 1u || depth + 1u >= BVH::MaxDepth)
+            return std::nullopt;
+
+        const auto split = find_split(state, first, count, bounds);
+        const Float32 leaf_cost = IntersectionCost * Float32(count);
+        if (split && (split->Cost < leaf_cost || count > MaxLeafSize)) {
+            const Float32
+                min   = bounds.Centers.Min[split->Axis],
+                scale = Float32(split->BinCount) / (
+                    bounds.Centers.Max[split->Axis] - min
+                );
+            const auto is_left = [&](const Primitive& primitive) {
+                return get_bin(primitive.GetCenter()[split->Axis], min,
+                    scale, split->BinCount) <= split->Bin;
+            };
+            Partition result;
+            const auto add = [](NodeBounds& bounds,
+                    const Primitive& primitive) {
+                bounds.Bounds.Combine(primitive.Bounds);
+                bounds.Centers.Combine(primitive.GetCenter());
+            };
+            std::vector<Primitive>& primitives = state.Primitives;
+            UInt32
+                i = first,
+                j = first + count;
+            while (true) {
+                while (i < j && is_left(primitives[i]))
+                    add(result.Left, primitives[i++]);
+                while (i < j && !is_left(primitives[j - 1u]))
+                    add(result.Right, primitives[--j]);
+                if (i == j)
+                    break;
+                std::swap(primitives[i], primitives[j - 1u]);
+                add(result.Left,  primitives[i++]);
+                add(result.Right, primitives[--j]);
+            }
+            result.Middle = i;
+            return result;
+        } else if (count > MaxLeafSize) {
+            // All centers coincide, so any split is as good as another
+            const UInt32 middle = first + count / 2u;
+            return Partition {
+                middle,
+                get_bounds(state, first, middle - first),
+                get_bounds(state, middle, first + count - middle)
+            };
+        }
+        return std::nullopt;
+    }
+
+    // Builds the subtree over [first, first + count) and appends its nodes
+    // in depth first order. Offsets of interior nodes are relative to the
+    // start of nodes.
+    static UInt32 build_node(BuildState& state, std::vector<BVH::Node>& nodes,
+            UInt32 first, UInt32 count, UCount depth,
+            const NodeBounds& bounds) {
+        const UInt32 node_index = UInt32(nodes.size());
+        nodes.emplace_back();
+        nodes[node_index].Bounds = bounds.Bounds.ToAABB();
+
+        const auto halves = partition(state, first, count, depth, bounds);
+        if (!halves) {
+            nodes[node_index].Offset = first;
+            nodes[node_index].Count  = count;
+            return node_index;
+        }
+
+        const UInt32 middle = halves->Middle;
+        build_node(state, nodes, first, middle - first, depth + 1u,
+            halves->Left);
+        const UInt32 right = build_node(state, nodes, middle,
+            first + count - middle, depth + 1u, halves->Right);
+        nodes[node_index].Offset = right;
+        nodes[node_index].Count  = 0u;
+        return node_index;
+    }
+
+    // The top of the tree is built on the calling thread with all threads
+    // helping out on the large nodes; the subtrees below it are then built
+    // in parallel, one per task, and spliced in at the end.
+    struct TopNode {
+        AABB   Bounds;
+        // Children within the top nodes, if this is an interior node
+        UInt32 Left, Right;
+        // The subtree or leaf that takes the place of this node otherwise
+        std::optional<UIndex> Subtree;
+    };
+
+    struct Subtree {
+        UInt32                 First, Count;
+        UCount                 Depth;
+        NodeBounds             Bounds;
+        std::vector<BVH::Node> Nodes;
+    };
+
+    static UInt32 build_top_node(BuildState& state,
+            std::vector<TopNode>& top_nodes, std::vector<Subtree>& subtrees,
+            UInt32 first, UInt32 count, UCount depth,
+            const NodeBounds& bounds, UCount subtree_size) {
+        const UInt32 node_index = UInt32(top_nodes.size());
+        top_nodes.emplace_back();
+        top_nodes[node_index].Bounds = bounds.Bounds.ToAABB();
+
+        const auto halves = count > subtree_size
+            ? partition(state, first, count, depth, bounds)
+            : std::nullopt;
+        if (!halves) {
+            top_nodes[node_index].Subtree = subtrees.size();
+            subtrees.push_back({ first, count, depth, bounds, { } });
+            return node_index;
+        }
+
+        const UInt32
+            middle = halves->Middle,
+            left   = build_top_node(state, top_nodes, subtrees, first,
+                middle - first, depth + 1u, halves->Left, subtree_size),
+            right  = build_top_node(state, top_nodes, subtrees, middle,
+                first + count - middle, depth + 1u, halves->Right,
+                subtree_size);
+        top_nodes[node_index].Left  = left;
+        top_nodes[node_index].Right = right;
+        return node_index;
+    }
+
+    static void splice_top_node(const std::vector<TopNode>& top_nodes,
+            const std::vector<Subtree>& subtrees, UInt32 top_index,
+            std::vector<BVH::Node>& nodes) {
+        const TopNode& top_node = top_nodes[top_index];
+        if (top_node.Subtree) {
+            const UInt32 base = UInt32(nodes.size());
+            for (BVH::Node node : subtrees[*top_node.Subtree].Nodes) {
+                if (!node.IsLeaf())
+                    node.Offset += base;
+                nodes.push_back(node);
+            }
+            return;
+        }
+        const UInt32 node_index = UInt32(nodes.size());
+        nodes.push_back({ top_node.Bounds, 0u, 0u });
+        splice_top_node(top_nodes, subtrees, top_node.Left, nodes);
+        nodes[node_index].Offset = UInt32(nodes.size());
+        splice_top_node(top_nodes, subtrees, top_node.Right, nodes);
+    }
+
+    // Collapses the binary subtree below node into a wide node by opening
+    // the interior child with the largest surface area until the node is
+    // full, which keeps the nodes that are most likely to be hit together.
+    // Returns the index of the wide node.
+    static UInt32 collapse_node(const std::vector<BVH::Node>& nodes,
+            std::vector<BVH::WideNode>& wide_nodes, UInt32 node) {
+        std::array<UInt32, BVH::Width> children;
+        UCount child_count = 0u;
+        if (nodes[node].IsLeaf()) {
+            children[child_count++] = node;
+        } else {
+            children[child_count++] = node + 1u;
+            children[child_count++] = nodes[node].Offset;
+        }
+        while (child_count < BVH::Width) {
+            std::optional<UIndex> largest;
+            Float32 largest_area = 0.0f;
+            for (UIndex i = 0u; i < child_count; i++) {
+                const BVH::Node& child = nodes[children[i]];
+                const Float32 area = child.Bounds.GetSurfaceArea();
+                if (!child.IsLeaf() && (!largest || area > largest_area)) {
+                    largest      = i;
+                    largest_area = area;
+                }
+            }
+            if (!largest)
+                break;
+            const UInt32 opened = children[*largest];
+            children[*largest]      = opened + 1u;
+            children[child_count++] = nodes[opened].Offset;
+        }
+
+        const UInt32 wide_index = UInt32(wide_nodes.size());
+        wide_nodes.emplace_back();
+        for (UIndex i = 0u; i < child_count; i++) {
+            const BVH::Node& child = nodes[children[i]];
+            const Vec3
+                min = child.Bounds.GetMin(),
+                max = child.Bounds.GetMax();
+            UInt32 offset = child.Offset;
+            if (!child.IsLeaf())
+                offset = collapse_node(nodes, wide_nodes, children[i]);
+            BVH::WideNode& wide_node = wide_nodes[wide_index];
+            for (UIndex axis = 0u; axis < 3u; axis++) {
+                wide_node.Bounds[axis][i]      = min[axis];
+                wide_node.Bounds[axis + 3u][i] = max[axis];
+            }
+            wide_node.Child[i] = offset;
+            wide_node.Count[i] = child.Count;
+        }
+        return wide_index;
+    }
+
+    BVH::WideNode::WideNode() {
+        constexpr Float32 infinity = std::numeric_limits<Float32>::infinity();
+        for (UIndex i = 0u; i < Width; i++) {
+            for (UIndex axis = 0u; axis < 3u; axis++) {
+                Bounds[axis][i]      =  infinity;
+                Bounds[axis + 3u][i] = -infinity;
+            }
+            Child[i] = 0u;
+            Count[i] = 0u;
+        }
+    }
+
+    BVH::TraversalRay::TraversalRay(const Ray& ray)
+        : Origin(ray.Origin)
+        , InverseDirection(1.0f / ray.Direction)
+    {
+        // The sign of the inverse also covers directions of -0, for which
+        // the entry distance is -infinity at the maximum
+        for (UIndex axis = 0u; axis < 3u; axis++) {
+            const bool negative = InverseDirection[axis] < 0.0f;
+            Near[axis] = negative ? axis + 3u : axis;
+            Far[axis]  = negative ? axis      : axis + 3u;
+        }
+    }
+
+    std::optional<BVH::PacketBounds> BVH::GetPacketBounds(const Ray* rays,
+            UCount count) {
+        constexpr Float32 infinity = std::numeric_limits<Float32>::infinity();
+        Vec3
+            origin_min( infinity),
+            origin_max(-infinity),
+            inverse_min( infinity),
+            inverse_max(-infinity);
+        for (UIndex i = 0u; i < count; i++) {
+            const Vec3 inverse = 1.0f / rays[i].Direction;
+            origin_min  = glm::min(origin_min,  rays[i].Origin);
+            origin_max  = glm::max(origin_max,  rays[i].Origin);
+            inverse_min = glm::min(inverse_min, inverse);
+            inverse_max = glm::max(inverse_max, inverse);
+        }
+        PacketBounds bounds;
+        for (UIndex axis = 0u; axis < 3u; axis++) {
+            // See TraversalRay for the choice of planes
+            const bool negative = inverse_max[axis] < 0.0f;
+            if (!negative && inverse_min[axis] < 0.0f)
+                return std::nullopt;
+            bounds.Near[axis]       = negative ? axis + 3u : axis;
+            bounds.Far[axis]        = negative ? axis      : axis + 3u;
+            bounds.NearOrigin[axis] =
+                negative ? origin_min[axis] : origin_max[axis];
+            bounds.FarOrigin[axis]  =
+                negative ? origin_max[axis] : origin_min[axis];
+        }
+        bounds.InverseMin = inverse_min;
+        bounds.InverseMax = inverse_max;
+        return bounds;
+    }
+
+    void BVH::Build(const std::vector<AABB>& bounds, ThreadPool* pool) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        Clear();
+        if (bounds.empty())
+            return;
+        const UInt32 count = UInt32(bounds.size());
+        m_indices.resize(count);
+        m_nodes.reserve(2u * count - 1u);
+
+        if (pool && pool->GetThreadCount() == 1u)
+            pool = nullptr;
+        BuildState state { std::vector<Primitive>(count), pool };
+        for_parts(pool, 0u, count, Empty(), [&](UInt32 begin, UInt32 end,
+                Empty&) {
+            for (UInt32 i = begin; i < end; i++) {
+                const AABB& aabb = bounds[i];
+                state.Primitives[i] = {
+                    { aabb.GetMin(), aabb.GetMax() },
+                    i
+                };
+            }
+        });
+
+        const UCount subtree_size = pool
+            ? std::max(
+                MinParallelSubtree,
+                count / (SubtreesPerThread * pool->GetThreadCount())
+            )
+            : count;
+        const NodeBounds root_bounds = get_bounds(state, 0u, count);
+        if (count <= subtree_size) {
+            state.Pool = nullptr;
+            build_node(state, m_nodes, 0u, count, 0u, root_bounds);
+        } else {
+            std::vector<TopNode> top_nodes;
+            std::vector<Subtree> subtrees;
+            build_top_node(state, top_nodes, subtrees, 0u, count, 0u,
+                root_bounds, subtree_size);
+
+            // Start with the largest subtrees to balance the load
+            std::vector<UIndex> order(subtrees.size());
+            std::iota(order.begin(), order.end(), UIndex(0u));
+            std::sort(order.begin(), order.end(), [&](UIndex a, UIndex b) {
+                return subtrees[a].Count > subtrees[b].Count;
+            });
+            state.Pool = nullptr;
+            pool->ParallelFor(subtrees.size(), [&](UIndex i, UIndex) {
+                Subtree& subtree = subtrees[order[i]];
+                subtree.Nodes.reserve(2u * subtree.Count - 1u);
+                build_node(state, subtree.Nodes, subtree.First,
+                    subtree.Count, subtree.Depth, subtree.Bounds);
+            });
+            splice_top_node(top_nodes, subtrees, 0u, m_nodes);
+        }
+        for_parts(pool, 0u, count, Empty(), [&](UInt32 begin, UInt32 end,
+                Empty&) {
+            for (UInt32 i = begin; i < end; i++)
+                m_indices[i] = state.Primitives[i].Index;
+        });
+
+        Collapse();
+
+        const auto end = std::chrono::high_resolution_clock::now();
+        m_stats = ComputeStats();
+        m_stats.BuildCost = m_stats.Cost;
+        m_stats.BuildTime =
+            std::chrono::duration<Float64, std::milli>(end - start).count();
+    }
+
+    void BVH::Refit(const std::vector<AABB>& bounds) {
+        BEAM_DEBUG_ONLY {
+            if (bounds.size() != m_indices.size())
+                throw std::runtime_error("Wrong number of bounds to refit.");
+        }
+        // Children always come after their parent, so going backwards
+        // updates every node after its children.
+        for (UIndex i = m_nodes.size(); i-- > 0u;) {
+            Node& node = m_nodes[i];
+            node.Bounds = AABB::Nothing();
+            if (node.IsLeaf()) {
+                for (UIndex j = node.Offset; j < node.Offset + node.Count; j++)
+                    node.Bounds.Combine(bounds[j]);
+            } else {
+                node.Bounds.Combine(m_nodes[i + 1u].Bounds);
+                node.Bounds.Combine(m_nodes[node.Offset].Bounds);
+            }
+        }
+        m_stats.Cost = ComputeStats().Cost;
+        Collapse();
+        m_stats.WideNodeCount = m_wide_nodes.size();
+    }
+
+    void BVH::Clear() {
+        m_nodes.clear();
+        m_wide_nodes.clear();
+        m_indices.clear();
+        m_stats = Stats();
+    }
+
+    void BVH::Collapse() {
+        m_wide_nodes.clear();
+        if (m_nodes.empty())
+            return;
+        // Every wide node stands in for at least one interior binary node
+        m_wide_nodes.reserve(m_nodes.size() / 2u + 1u);
+        collapse_node(m_nodes, m_wide_nodes, 0u);
+    }
+
+    BVH::Stats BVH::ComputeStats() const {
+        Stats stats;
+        stats.PrimitiveCount = m_indices.size();
+        stats.NodeCount      = m_nodes.size();
+        stats.WideNodeCount  = m_wide_nodes.size();
+        if (m_nodes.empty())
+            return stats;
+        const Float32 root_area = m_nodes[0].Bounds.GetSurfaceArea();
+        Float64 cost = 0.0;
+        for (const Node& node : m_nodes) {
+            const Float64 area = node.Bounds.GetSurfaceArea();
+            if (node.IsLeaf()) {
+                stats.LeafCount++;
+                cost += IntersectionCost * area * Float64(node.Count);
+            } else {
+                cost += TraversalCost * area;
+            }
+        }
+        stats.Cost = root_area > 0.0f ? Float32(cost / root_area) : 0.0f;
+        return stats;
+    }
+
+}
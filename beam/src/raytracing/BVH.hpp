@@ -0,0 +1,351 @@
+#pragma once
+#include "raytracing/AABB.hpp"
+#include "ThreadPool.hpp"
+#include "SIMD.hpp"
+
+namespace beam {
+
+    // Bounding volume hierarchy built with the surface area heuristic.
+    // The hierarchy only knows the bounding boxes of the primitives it was
+    // built from; testing the primitives themselves is left to the owner.
+    //
+    // The binary tree that is built is collapsed into a tree with Width
+    // children per node for traversal, so that a ray is tested against all
+    // children of a node at once with SIMD.
+    class BVH {
+    public:
+        static constexpr UCount MaxDepth = 64u;
+#if defined(BEAM_SIMD)
+        static constexpr UCount Width    = simd::Width;
+#else
+        static constexpr UCount Width    = 4u;
+#endif
+
+        struct Node {
+            AABB   Bounds;
+            // For a leaf, the position of its first primitive in the index
+            // list; for an interior node, the index of its second child.
+            // The first child of an interior node always directly follows it.
+            UInt32 Offset;
+            // The number of primitives in a leaf, or zero for interior nodes.
+            UInt32 Count;
+
+            inline bool IsLeaf() const { return Count > 0u; }
+        };
+
+        // A node of the wide tree. The bounds of the children are stored
+        // per axis so that they load straight into SIMD registers, as
+        // minimum x, y, z and maximum x, y, z. Unused children have empty
+        // bounds, which no ray enters.
+        struct alignas(64) WideNode {
+            Float32 Bounds[6][Width];
+            // For a leaf child, the position of its first primitive in the
+            // index list; for an interior child, the index of its node.
+            UInt32  Child[Width];
+            // The number of primitives in a leaf child, or zero otherwise.
+            UInt32  Count[Width];
+
+            WideNode();
+        };
+
+        struct Stats {
+            UCount  PrimitiveCount = 0u;
+            UCount  NodeCount      = 0u;
+            UCount  LeafCount      = 0u;
+            UCount  WideNodeCount  = 0u;
+            // The expected cost of finding the closest hit of a random ray
+            // that hits the root, according to the surface area heuristic
+            Float32 Cost           = 0.0f;
+            // The cost right after the last build; refitting only changes
+            // the current cost
+            Float32 BuildCost      = 0.0f;
+            // In milliseconds
+            Float64 BuildTime      = 0.0;
+        };
+
+        // Builds the hierarchy over the given bounding boxes. With a thread
+        // pool, the top of the tree is built with all threads helping out on
+        // the large nodes and the subtrees below it are built in parallel.
+        // Must not be called from within a task of the pool.
+        void Build(const std::vector<AABB>& bounds,
+            ThreadPool* pool = nullptr);
+        // Recomputes the bounds of every node after the primitives moved,
+        // keeping the structure of the hierarchy. The bounds are given by
+        // position in the index list, like the leaves refer to them. The
+        // tree gets worse the further the primitives move from where they
+        // were during the build; see GetStats.
+        void Refit(const std::vector<AABB>& bounds);
+        void Clear();
+
+        inline bool IsEmpty() const { return m_nodes.empty(); }
+        // Describes the hierarchy as of the last build.
+        inline const Stats& GetStats() const { return m_stats; }
+
+        inline const std::vector<Node>&   GetNodes()   const {
+            return m_nodes;
+        }
+        inline const std::vector<UInt32>& GetIndices() const {
+            return m_indices;
+        }
+        inline const std::vector<WideNode>& GetWideNodes() const {
+            return m_wide_nodes;
+        }
+
+        // Calls intersect(first, count) for every leaf that the ray enters
+        // before t_max, visiting the nearest nodes first. The primitives of
+        // the leaf are found at positions [first, first + count) of the index
+        // list; owners that store their primitives in that order can use the
+        // positions directly. The callback may lower t_max when it finds a
+        // closer hit, which prunes the rest of the traversal.
+        template <typename IntersectFunc>
+        void Traverse(const Ray& ray, Float32& t_max,
+                IntersectFunc&& intersect) const {
+            const TraversalRay traversal_ray(ray);
+            TraverseNodes(t_max,
+                [&](const WideNode& node, Float32* distances) {
+                    return IntersectChildren(node, traversal_ray, t_max,
+                        distances);
+                },
+                intersect);
+        }
+
+        // Calls intersect(first, count) for the leaves that the ray enters
+        // before t_max until it returns true, meaning it found a hit in the
+        // leaf, and returns whether it did. For queries that only need to
+        // know whether there is any hit, like shadow rays.
+        template <typename IntersectFunc>
+        bool TraverseAny(const Ray& ray, Float32 t_max,
+                IntersectFunc&& intersect) const {
+            bool found = false;
+            Traverse(ray, t_max, [&](UInt32 first, UInt32 count) {
+                if (intersect(first, count)) {
+                    found = true;
+                    // No node is entered before this, which ends the
+                    // traversal
+                    t_max = -std::numeric_limits<Float32>::infinity();
+                }
+            });
+            return found;
+        }
+
+        // Conservative bounds on a packet of rays: the ranges of their
+        // origins and inverse directions on every axis. A box that none of
+        // the rays can enter according to these ranges is missed by all of
+        // them, so the packet is tested against the nodes as a whole.
+        struct PacketBounds {
+            // The origins from which the entry and exit distances are
+            // measured, which are the ones that minimize and maximize them
+            Vec3   NearOrigin;
+            Vec3   FarOrigin;
+            Vec3   InverseMin;
+            Vec3   InverseMax;
+            UIndex Near[3];
+            UIndex Far[3];
+        };
+
+        // Returns std::nullopt if the directions of the rays differ in sign
+        // on some axis; such packets need to be traced ray by ray.
+        static std::optional<PacketBounds> GetPacketBounds(const Ray* rays,
+            UCount count);
+
+        // Like Traverse for a packet of rays with the given bounds, whose
+        // closest hits so far are given by hits. Nodes are visited as long
+        // as any of the rays might enter them, and intersect is called once
+        // per leaf for the whole packet; testing the rays individually is
+        // left to the callback.
+        template <typename IntersectFunc>
+        void TraversePacket(const PacketBounds& bounds, const Hit* hits,
+                UCount count, IntersectFunc&& intersect) const {
+            const auto get_t_max = [&]() {
+                Float32 t_max = 0.0f;
+                for (UIndex i = 0u; i < count; i++)
+                    t_max = std::max(t_max, hits[i].Distance);
+                return t_max;
+            };
+            Float32 t_max = get_t_max();
+            TraverseNodes(t_max,
+                [&](const WideNode& node, Float32* distances) {
+                    return IntersectChildren(node, bounds, t_max, distances);
+                },
+                [&](UInt32 first, UInt32 leaf_count) {
+                    intersect(first, leaf_count);
+                    t_max = get_t_max();
+                });
+        }
+    private:
+        std::vector<Node>     m_nodes;
+        std::vector<WideNode> m_wide_nodes;
+        std::vector<UInt32>   m_indices;
+        Stats                 m_stats;
+
+        // A ray prepared for testing it against many boxes
+        struct TraversalRay {
+            Vec3   Origin;
+            Vec3   InverseDirection;
+            // The rows of WideNode::Bounds where the ray enters and leaves
+            // the boxes on each axis, which depend on the sign of its
+            // direction
+            UIndex Near[3];
+            UIndex Far[3];
+
+            TraversalRay(const Ray& ray);
+        };
+
+        // Tests the ray against the children of the node. Returns a bit for
+        // every child that the ray enters before t_max and writes the
+        // distances at which it enters them.
+        static inline UInt32 IntersectChildren(const WideNode& node,
+                const TraversalRay& ray, Float32 t_max, Float32* distances) {
+#if defined(BEAM_SIMD)
+            static_assert(Width == simd::Width);
+            using simd::Float;
+            Float
+                t_near = Float::Broadcast(0.0f),
+                t_far  = Float::Broadcast(t_max);
+            for (UIndex axis = 0u; axis < 3u; axis++) {
+                const Float
+                    origin  = Float::Broadcast(ray.Origin[axis]),
+                    inverse = Float::Broadcast(ray.InverseDirection[axis]);
+                // Distances that are NaN (the ray lies in a slab plane)
+                // are passed over, like in the scalar version
+                t_near = simd::max(
+                    (Float::Load(node.Bounds[ray.Near[axis]]) - origin)
+                        * inverse,
+                    t_near);
+                t_far  = simd::min(
+                    (Float::Load(node.Bounds[ray.Far[axis]]) - origin)
+                        * inverse,
+                    t_far);
+            }
+            t_near.Store(distances);
+            return (t_near <= t_far).GetBits();
+#else
+            UInt32 hits = 0u;
+            for (UIndex i = 0u; i < Width; i++) {
+                Float32
+                    t_near = 0.0f,
+                    t_far  = t_max;
+                for (UIndex axis = 0u; axis < 3u; axis++) {
+                    t_near = std::max(t_near,
+                        (node.Bounds[ray.Near[axis]][i] - ray.Origin[axis])
+                            * ray.InverseDirection[axis]);
+                    t_far  = std::min(t_far,
+                        (node.Bounds[ray.Far[axis]][i] - ray.Origin[axis])
+                            * ray.InverseDirection[axis]);
+                }
+                distances[i] = t_near;
+                if (t_near <= t_far)
+                    hits |= 1u << i;
+            }
+            return hits;
+#endif
+        }
+
+        // Tests the packet against the children of the node, like the other
+        // overload does for a single ray. The distances are lower bounds for
+        // the rays of the packet.
+        static inline UInt32 IntersectChildren(const WideNode& node,
+                const PacketBounds& packet, Float32 t_max,
+                Float32* distances) {
+#if defined(BEAM_SIMD)
+            using simd::Float;
+            Float
+                t_near = Float::Broadcast(0.0f),
+                t_far  = Float::Broadcast(t_max);
+            for (UIndex axis = 0u; axis < 3u; axis++) {
+                const Float
+                    inverse_min = Float::Broadcast(packet.InverseMin[axis]),
+                    inverse_max = Float::Broadcast(packet.InverseMax[axis]),
+                    near = Float::Load(node.Bounds[packet.Near[axis]])
+                        - Float::Broadcast(packet.NearOrigin[axis]),
+                    far  = Float::Load(node.Bounds[packet.Far[axis]])
+                        - Float::Broadcast(packet.FarOrigin[axis]);
+                t_near = simd::max(
+                    simd::min(near * inverse_min, near * inverse_max),
+                    t_near);
+                t_far  = simd::min(
+                    simd::max(far * inverse_min, far * inverse_max),
+                    t_far);
+            }
+            t_near.Store(distances);
+            return (t_near <= t_far).GetBits();
+#else
+            UInt32 hits = 0u;
+            for (UIndex i = 0u; i < Width; i++) {
+                Float32
+                    t_near = 0.0f,
+                    t_far  = t_max;
+                for (UIndex axis = 0u; axis < 3u; axis++) {
+                    const Float32
+                        near = node.Bounds[packet.Near[axis]][i]
+                            - packet.NearOrigin[axis],
+                        far  = node.Bounds[packet.Far[axis]][i]
+                            - packet.FarOrigin[axis];
+                    t_near = std::max(t_near, std::min(
+                        near * packet.InverseMin[axis],
+                        near * packet.InverseMax[axis]
+                    ));
+                    t_far  = std::min(t_far, std::max(
+                        far * packet.InverseMin[axis],
+                        far * packet.InverseMax[axis]
+                    ));
+                }
+                distances[i] = t_near;
+                if (t_near <= t_far)
+                    hits |= 1u << i;
+            }
+            return hits;
+#endif
+        }
+
+        // Visits the nodes in the order of the distances at which
+        // intersect_children says they are entered, calling intersect for
+        // the leaves, until none are left that are entered before t_max.
+        template <typename IntersectChildrenFunc, typename IntersectFunc>
+        void TraverseNodes(const Float32& t_max,
+                IntersectChildrenFunc&& intersect_children,
+                IntersectFunc&& intersect) const {
+            if (m_wide_nodes.empty())
+                return;
+            struct Entry {
+                UInt32  Child;
+                UInt32  Count;
+                Float32 Distance;
+            };
+            // Every level of the tree leaves at most Width - 1 children on
+            // the stack
+            std::array<Entry, MaxDepth * Width> stack;
+            UCount stack_size = 0u;
+            stack[stack_size++] = { 0u, 0u, 0.0f };
+            while (stack_size > 0u) {
+                const Entry entry = stack[--stack_size];
+                if (entry.Distance >= t_max)
+                    continue;
+                if (entry.Count > 0u) {
+                    intersect(entry.Child, entry.Count);
+                    continue;
+                }
+                const WideNode& node = m_wide_nodes[entry.Child];
+                Float32 distances[Width];
+                const UInt32 hits = intersect_children(node, distances);
+                // Push the children that were hit farthest first, so that
+                // the nearest one is visited next
+                const UCount first = stack_size;
+                for (UIndex i = 0u; i < Width; i++) {
+                    if (!(hits & (1u << i)))
+                        continue;
+                    UCount j = stack_size++;
+                    for (; j > first && stack[j - 1u].Distance < distances[i];
+                            j--)
+                        stack[j] = stack[j - 1u];
+                    stack[j] = { node.Child[i], node.Count[i], distances[i] };
+                }
+            }
+        }
+
+        Stats ComputeStats() const;
+        // Builds the wide tree from the binary one.
+        void Collapse();
+    };
+
+}
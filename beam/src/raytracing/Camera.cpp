@@ -1,8 +1,73 @@
 #include "Common.hpp"
 #include "Camera.hpp"
+#include "SIMD.hpp"
 
 namespace beam {
 
+    // Maps a point uniform in [0, 1)^2 to a point uniform on the unit disk,
+    // keeping nearby points close together so that the stratification of
+    // the samples carries over (Shirley and Chiu, "A Low Distortion Map
+    // Between Disk and Square", 1997).
+    static Vec2 sample_concentric_disk(const Vec2& uv) {
+        const Vec2 p = 2.0f * uv - 1.0f;
+        if (p.x == 0.0f && p.y == 0.0f)
+            return Vec2(0.0f);
+        const Float32 quarter_pi = 0.25f * glm::pi<Float32>();
+        const bool    horizontal = std::abs(p.x) > std::abs(p.y);
+        const Float32
+            r   = horizontal ? p.x : p.y,
+            phi = horizontal
+                ? quarter_pi * (p.y / p.x)
+                : 2.0f * quarter_pi - quarter_pi * (p.x / p.y);
+        return { r * std::cos(phi), r * std::sin(phi) };
+    }
+
+    // CameraSamples
+
+    void CameraSamples::Add(Float32 u, Float32 v, const Vec2& lens) {
+        const Vec2 disk = sample_concentric_disk(lens);
+        U.push_back(u);
+        V.push_back(v);
+        LensX.push_back(disk.x);
+        LensY.push_back(disk.y);
+    }
+
+    void CameraSamples::Set(UIndex i, Float32 u, Float32 v,
+            const Vec2& lens) {
+        const Vec2 disk = sample_concentric_disk(lens);
+        U[i]     = u;
+        V[i]     = v;
+        LensX[i] = disk.x;
+        LensY[i] = disk.y;
+    }
+
+    void CameraSamples::Resize(UCount count) {
+        U.resize(count);
+        V.resize(count);
+        LensX.resize(count);
+        LensY.resize(count);
+    }
+
+    void CameraSamples::Clear() {
+        U.clear();
+        V.clear();
+        LensX.clear();
+        LensY.clear();
+    }
+
+    // CameraRays
+
+    void CameraRays::Resize(UCount count) {
+        OriginX.resize(count);
+        OriginY.resize(count);
+        OriginZ.resize(count);
+        DirectionX.resize(count);
+        DirectionY.resize(count);
+        DirectionZ.resize(count);
+    }
+
+    // Camera
+
     Camera::Camera(Float32 aspect, Float32 fov_deg, Vec3 position,
             Vec3 direction, Float32 focal_distance, Float32 aperture_radius)
         : m_position(position)
@@ -14,16 +79,56 @@ namespace beam {
         , m_screen_aspect(aspect)
         , m_focal_distance(focal_distance)
         , m_aperture_radius(aperture_radius)
-    { }
+        , m_revision(0u)
+    {
+        UpdateBasis();
+    }
 
-    Ray Camera::ScreenCoordsToRay(Float32 u, Float32 v) const {
-        const Float32 scale = m_focal_distance * m_screen_scale;
-        const Vec3 pixel_pos
-            = m_position
-            + m_focal_distance * m_forward
-            + (u - 0.5f) * scale * m_right
-            - (v - 0.5f) * scale * (1.0f / m_screen_aspect) * m_up;
-        return Ray(pixel_pos, glm::normalize(pixel_pos - m_position));
+    Ray Camera::ScreenCoordsToRay(Float32 u, Float32 v,
+            const Vec2& lens) const {
+        const Vec2 disk = sample_concentric_disk(lens);
+        return GenerateRay(u, v, disk.x, disk.y);
+    }
+
+    void Camera::GenerateRays(const CameraSamples& samples,
+            CameraRays& rays) const {
+        const UCount count = samples.GetCount();
+        rays.Resize(count);
+        UIndex i = 0u;
+#if defined(BEAM_SIMD)
+        // The same as GenerateRay, simd::Width rays at a time
+        using simd::Float;
+        constexpr UCount width = simd::Width;
+        const simd::Vec3
+            corner     = simd::Vec3::Broadcast(m_corner),
+            horizontal = simd::Vec3::Broadcast(m_horizontal),
+            vertical   = simd::Vec3::Broadcast(m_vertical),
+            position   = simd::Vec3::Broadcast(m_position),
+            lens_right = simd::Vec3::Broadcast(m_lens_right),
+            lens_up    = simd::Vec3::Broadcast(m_lens_up);
+        const Float one = Float::Broadcast(1.0f);
+        for (; i + width <= count; i += width) {
+            const simd::Vec3
+                target = corner
+                    + horizontal * Float::Load(samples.U.data() + i)
+                    + vertical   * Float::Load(samples.V.data() + i),
+                origin = position
+                    + lens_right * Float::Load(samples.LensX.data() + i)
+                    + lens_up    * Float::Load(samples.LensY.data() + i),
+                offset = target - origin,
+                direction =
+                    offset * (one / simd::sqrt(simd::dot(offset, offset)));
+            origin.X.Store(rays.OriginX.data() + i);
+            origin.Y.Store(rays.OriginY.data() + i);
+            origin.Z.Store(rays.OriginZ.data() + i);
+            direction.X.Store(rays.DirectionX.data() + i);
+            direction.Y.Store(rays.DirectionY.data() + i);
+            direction.Z.Store(rays.DirectionZ.data() + i);
+        }
+#endif
+        for (; i < count; i++)
+            rays.Set(i, GenerateRay(samples.U[i], samples.V[i],
+                samples.LensX[i], samples.LensY[i]));
     }
 
     void Camera::Move(const Vec3& movement) {
@@ -31,12 +136,14 @@ namespace beam {
             + movement.x * m_right
             + movement.y * Vec3 {0.0f, 1.0f, 0.0f}
             + movement.z * m_forward;
+        UpdateBasis();
     }
 
     void Camera::ResetRotation() {
         m_forward = Vec3(0.0f, 0.0f, 1.0f);
         m_up      = Vec3(0.0f, 1.0f, 0.0f);
         m_right   = glm::cross(m_up, m_forward);
+        UpdateBasis();
     }
 
     void Camera::RotateVertically(Float32 angle_deg) {
@@ -45,6 +152,7 @@ namespace beam {
         m_forward = rotMatrix * Vec4(m_forward, 0.0f);
         m_right   = rotMatrix * Vec4(m_right, 0.0f);
         m_up      = rotMatrix * Vec4(m_up, 0.0f);
+        UpdateBasis();
     }
 
     void Camera::RotateHorizontally(Float32 angle_deg) {
@@ -54,6 +162,29 @@ namespace beam {
         m_forward = rotMatrix * Vec4(m_forward, 0.0f);
         m_right   = rotMatrix * Vec4(m_right, 0.0f);
         m_up      = rotMatrix * Vec4(m_up, 0.0f);
+        UpdateBasis();
+    }
+
+
+    void Camera::UpdateBasis() {
+        const Float32 scale = m_focal_distance * m_screen_scale;
+        m_horizontal = scale * m_right;
+        m_vertical   = -(scale / m_screen_aspect) * m_up;
+        m_corner     = m_position + m_focal_distance * m_forward
+                     - 0.5f * (m_horizontal + m_vertical);
+        m_lens_right = m_aperture_radius * m_right;
+        m_lens_up    = m_aperture_radius * m_up;
+        m_revision++;
+    }
+
+    Ray Camera::GenerateRay(Float32 u, Float32 v, Float32 lens_x,
+            Float32 lens_y) const {
+        const Vec3
+            target = m_corner + u * m_horizontal + v * m_vertical,
+            origin = m_position + lens_x * m_lens_right + lens_y * m_lens_up,
+            offset = target - origin;
+        const Float32 inv_length = 1.0f / std::sqrt(glm::dot(offset, offset));
+        return Ray(origin, offset * inv_length);
     }
 
 }
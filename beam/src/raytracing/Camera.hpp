@@ -3,29 +3,91 @@
 
 namespace beam {
 
+    // The camera samples of a batch of rays, such as the samples of a tile,
+    // in structure of arrays form: the screen coordinates of every sample
+    // and its position on the lens.
+    struct CameraSamples {
+        std::vector<Float32> U, V;
+        // A point on the unit disk
+        std::vector<Float32> LensX, LensY;
+
+        inline UCount GetCount() const { return U.size(); }
+
+        // The lens sample is uniform in [0, 1) and gets mapped onto the
+        // unit disk.
+        void Add(Float32 u, Float32 v, const Vec2& lens);
+        void Set(UIndex i, Float32 u, Float32 v, const Vec2& lens);
+        void Resize(UCount count);
+        void Clear();
+    };
+
+    // The rays generated from a batch of camera samples, in the same order.
+    struct CameraRays {
+        std::vector<Float32> OriginX, OriginY, OriginZ;
+        std::vector<Float32> DirectionX, DirectionY, DirectionZ;
+
+        inline UCount GetCount() const { return OriginX.size(); }
+
+        inline Ray Get(UIndex i) const {
+            return Ray(
+                { OriginX[i], OriginY[i], OriginZ[i] },
+                { DirectionX[i], DirectionY[i], DirectionZ[i] }
+            );
+        }
+
+        inline void Set(UIndex i, const Ray& ray) {
+            OriginX[i]    = ray.Origin.x;
+            OriginY[i]    = ray.Origin.y;
+            OriginZ[i]    = ray.Origin.z;
+            DirectionX[i] = ray.Direction.x;
+            DirectionY[i] = ray.Direction.y;
+            DirectionZ[i] = ray.Direction.z;
+        }
+
+        void Resize(UCount count);
+    };
+
+    // A thin lens camera. Rays start on a disk with the aperture radius
+    // around the position of the camera and go through the point they aim
+    // at on the plane at the focal distance, so only that plane is in
+    // focus. An aperture radius of zero gives a pinhole camera.
     class Camera {
     public:
         Camera(Float32 aspect, Float32 fov_deg, Vec3 position, Vec3 direction,
             Float32 focal_distance, Float32 aperture_radius);
-        
+
         inline Vec3 GetPosition() const { return m_position; }
 
-        Ray ScreenCoordsToRay(Float32 u, Float32 v) const;
-        
+        // Changes every time the camera is moved or reconfigured.
+        inline UInt64 GetRevision() const { return m_revision; }
+
+        // The lens sample is uniform in [0, 1); the default one is the
+        // center of the lens.
+        Ray ScreenCoordsToRay(Float32 u, Float32 v,
+            const Vec2& lens = Vec2(0.5f)) const;
+        // Generates the rays of every sample at once, several at a time
+        // when SIMD is available.
+        void GenerateRays(const CameraSamples& samples,
+            CameraRays& rays) const;
+
         inline void SetPosition(const Vec3& position) {
             m_position = position;
+            UpdateBasis();
         }
 
         inline void SetFOV(Float32 fov_deg) {
             m_screen_scale = FOVToScreenScale(fov_deg);
+            UpdateBasis();
         }
 
         inline void SetFocalDistance(Float32 focal_distance) {
             m_focal_distance = focal_distance;
+            UpdateBasis();
         }
 
         inline void SetApertureRadius(Float32 apreture_radius) {
             m_aperture_radius = apreture_radius;
+            UpdateBasis();
         }
 
         void Move(const Vec3& movement);
@@ -41,10 +103,25 @@ namespace beam {
                 m_screen_aspect,
                 m_focal_distance,
                 m_aperture_radius;
+        UInt64  m_revision;
+        // Derived from the above by UpdateBasis, so that generating a ray
+        // takes a few multiply-adds: the point on the focal plane at the
+        // screen coordinates (0, 0), the steps along it for a screen
+        // coordinate of one, and the axes of the lens scaled by its radius
+        Vec3    m_corner,
+                m_horizontal,
+                m_vertical,
+                m_lens_right,
+                m_lens_up;
 
         inline Float32 FOVToScreenScale(Float32 fov_deg) {
             return 2.0f * std::tan(0.5f * glm::radians(fov_deg));
         }
+
+        // Needs to be called after any of the members above changed.
+        void UpdateBasis();
+        Ray GenerateRay(Float32 u, Float32 v, Float32 lens_x,
+            Float32 lens_y) const;
     };
 
 }
@@ -0,0 +1,47 @@
+#include "Common.hpp"
+#include "Instance.hpp"
+
+namespace beam {
+
+    Instance::Instance(UInt32 mesh_id, const Mat4& transform,
+            const AABB& mesh_bounds)
+        : MeshID(mesh_id)
+    {
+        SetTransform(transform, mesh_bounds);
+    }
+
+    void Instance::SetTransform(const Mat4& transform,
+            const AABB& mesh_bounds) {
+        m_transform         = transform;
+        m_inverse_transform = glm::inverse(transform);
+        SetMeshBounds(mesh_bounds);
+    }
+
+    void Instance::SetMeshBounds(const AABB& mesh_bounds) {
+        // The bounds of the transformed corners of the mesh bounds
+        m_bounds = AABB::Nothing();
+        const Vec3
+            min = mesh_bounds.GetMin(),
+            max = mesh_bounds.GetMax();
+        for (UIndex corner = 0u; corner < 8u; corner++) {
+            const Vec3 point(
+                corner & 1u ? max.x : min.x,
+                corner & 2u ? max.y : min.y,
+                corner & 4u ? max.z : min.z
+            );
+            m_bounds.Combine(Vec3(m_transform * Vec4(point, 1.0f)));
+        }
+    }
+
+    Intersection Instance::ToWorldSpace(const Ray& ray, Float32 distance,
+            const Intersection& intersection) const {
+        // Normals transform with the inverse transpose
+        const Vec3 normal = glm::normalize(Vec3(
+            glm::transpose(m_inverse_transform)
+                * Vec4(intersection.Normal, 0.0f)
+        ));
+        return Intersection(ray.Traverse(distance), normal,
+            intersection.Material);
+    }
+
+}
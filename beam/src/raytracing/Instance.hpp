@@ -0,0 +1,45 @@
+#pragma once
+#include "raytracing/Raytracing.hpp"
+#include "raytracing/AABB.hpp"
+
+namespace beam {
+
+    // A placement of a mesh in the scene. Every instance of a mesh shares
+    // its triangles and BVH, so an instance only costs its transforms.
+    class Instance {
+    public:
+        // The index of the mesh within the scene
+        UInt32 MeshID;
+
+        Instance(UInt32 mesh_id, const Mat4& transform,
+            const AABB& mesh_bounds);
+
+        inline const Mat4& GetTransform()        const { return m_transform; }
+        inline const Mat4& GetInverseTransform() const {
+            return m_inverse_transform;
+        }
+        // The bounds of the transformed mesh
+        inline const AABB& GetBoundingBox() const { return m_bounds; }
+
+        void SetTransform(const Mat4& transform, const AABB& mesh_bounds);
+        // Updates the bounds after the mesh changed.
+        void SetMeshBounds(const AABB& mesh_bounds);
+
+        // Returns the ray in the space of the mesh. The direction isn't
+        // normalized, so distances along the ray stay the same.
+        inline Ray ToObjectSpace(const Ray& ray) const {
+            return Ray(
+                Vec3(m_inverse_transform * Vec4(ray.Origin,    1.0f)),
+                Vec3(m_inverse_transform * Vec4(ray.Direction, 0.0f))
+            );
+        }
+
+        Intersection ToWorldSpace(const Ray& ray, Float32 distance,
+            const Intersection& intersection) const;
+    private:
+        Mat4 m_transform;
+        Mat4 m_inverse_transform;
+        AABB m_bounds;
+    };
+
+}
@@ -0,0 +1,137 @@
+#include "Common.hpp"
+#include "Integrator.hpp"
+#include "Scene.hpp"
+
+namespace beam {
+
+    // Rays leaving a surface start this far above it, so that they don't
+    // hit it again due to rounding.
+    static constexpr Float32 ray_offset = 1.0e-4f;
+
+    // Returns a direction in the hemisphere around the normal with a
+    // density proportional to the cosine of its angle to the normal, for
+    // uv uniform in [0, 1).
+    static Vec3 sample_cosine_hemisphere(const Vec3& normal, const Vec2& uv) {
+        const auto [tangent, bitangent] = get_tangents(normal);
+
+        // Project a uniform point on the unit disk onto the hemisphere
+        const Float32
+            r   = std::sqrt(uv.x),
+            phi = glm::two_pi<Float32>() * uv.y;
+        const Float32
+            x = r * std::cos(phi),
+            y = r * std::sin(phi),
+            z = std::sqrt(std::max(0.0f, 1.0f - x * x - y * y));
+        return x * tangent + y * bitangent + z * normal;
+    }
+
+    Color PreviewIntegrator::Integrate(const Scene& scene, const Ray& ray,
+            const Hit* hit, const Color& sky_color, Sampler&) const {
+        if (!hit)
+            return sky_color;
+        return scene.GetIntersection(ray, *hit).Material.Color;
+    }
+
+    // Weighs a sample taken with one of two strategies by its density
+    // under both (the power heuristic with an exponent of two). Works on
+    // the ratio of the densities, since their squares overflow for tiny
+    // lights far away.
+    static inline Float32 get_mis_weight(Float32 pdf, Float32 other_pdf) {
+        if (!(pdf > 0.0f))
+            return 0.0f;
+        const Float32 ratio = other_pdf / pdf;
+        return 1.0f / (1.0f + ratio * ratio);
+    }
+
+    Color PathIntegrator::Integrate(const Scene& scene, const Ray& ray,
+            const Hit* hit, const Color& sky_color, Sampler& sampler) const {
+        PathState path;
+        Ray       path_ray = ray;
+        Hit       path_hit = hit ? *hit : Hit();
+        bool      found    = hit != nullptr;
+        while (found) {
+            std::optional<ShadowRay> shadow;
+            const bool next =
+                Shade(scene, path_ray, path_hit, path, sampler, shadow);
+            if (shadow && !scene.Intersects(shadow->Ray, shadow->Distance))
+                path.Radiance += shadow->Radiance;
+            if (!next)
+                return Color(path.Radiance, 1.0f);
+            path_hit = Hit();
+            found    = scene.Intersect(path_ray, path_hit);
+        }
+        Miss(path, sky_color);
+        return Color(path.Radiance, 1.0f);
+    }
+
+    bool PathIntegrator::Shade(const Scene& scene, Ray& ray, const Hit& hit,
+            PathState& path, Sampler& sampler,
+            std::optional<ShadowRay>& shadow) const {
+        const Intersection intersection = scene.GetIntersection(ray, hit);
+        const Material& material = intersection.Material;
+        const Vec3      albedo(material.Color);
+        if (material.Emission > 0.0f) {
+            // Light that was also sampled directly from the previous point
+            // only counts with its share of the weight
+            Float32 weight = 1.0f;
+            if (path.Depth > 0u)
+                weight = get_mis_weight(path.BouncePdf, scene.GetLightPdf(
+                    ray.Origin, path.BounceNormal, hit, intersection));
+            path.Radiance += weight * path.Throughput
+                * material.GetEmittedRadiance();
+        }
+        if (path.Depth >= m_max_depth)
+            return false;
+
+        // Bounce off the side of the surface that the ray came from
+        const Vec3 normal =
+            glm::dot(intersection.Normal, ray.Direction) > 0.0f
+                ? -intersection.Normal
+                : intersection.Normal;
+        const Vec3 origin = intersection.Point + ray_offset * normal;
+
+        // Every bounce takes the same dimensions of the sampler whether it
+        // uses them or not, so that the dimensions of later bounces don't
+        // shift
+        const Float32 light_u    = sampler.Get1D();
+        const Vec2    light_uv   = sampler.Get2D();
+        const Vec2    bounce_uv  = sampler.Get2D();
+        const Float32 roulette_u = sampler.Get1D();
+
+        // Sample a light directly; whether it's visible is up to the caller
+        if (const auto sample = scene.GetLights().Sample(origin, normal,
+                light_u, light_uv)) {
+            const Float32 cosine = glm::dot(normal, sample->Direction);
+            if (cosine > 0.0f) {
+                const Float32 brdf_pdf = cosine * glm::one_over_pi<Float32>();
+                shadow = ShadowRay {
+                    Ray(origin, sample->Direction),
+                    sample->Distance * (1.0f - ray_offset),
+                    get_mis_weight(sample->Pdf, brdf_pdf) * path.Throughput
+                        * albedo * brdf_pdf * sample->Radiance / sample->Pdf
+                };
+            }
+        }
+
+        // With cosine weighted directions, the cosine and the density cancel
+        // out with the 1 / pi of the diffuse BRDF
+        path.Throughput *= albedo;
+        if (path.Depth >= m_roulette_depth) {
+            const Vec3& throughput = path.Throughput;
+            const Float32 survival = std::min(0.95f, std::max(
+                throughput.x, std::max(throughput.y, throughput.z)));
+            if (roulette_u >= survival)
+                return false;
+            path.Throughput /= survival;
+        }
+
+        const Vec3 direction = sample_cosine_hemisphere(normal, bounce_uv);
+        path.BouncePdf    = glm::dot(normal, direction)
+            * glm::one_over_pi<Float32>();
+        path.BounceNormal = normal;
+        path.Depth++;
+        ray = Ray(origin, direction);
+        return true;
+    }
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "raytracing/Raytracing.hpp"
+#include "Sampler.hpp"
+
+namespace beam {
+
+    class Scene;
+
+    // Computes the light that arrives at the camera along a camera ray. The
+    // scene traces the camera rays itself, in packets, and hands their
+    // closest hits to the integrator.
+    class Integrator {
+    public:
+        virtual ~Integrator() { }
+
+        // hit is null if the ray didn't hit anything. Any random numbers
+        // come from the path dimensions of the sampler, which has been
+        // started on the sample, so that the result only depends on the
+        // sample.
+        virtual Color Integrate(const Scene& scene, const Ray& ray,
+            const Hit* hit, const Color& sky_color, Sampler& sampler)
+            const = 0;
+    };
+
+    // Returns the color of the surface that the camera sees, without any
+    // lighting. Much faster than path tracing, for previews.
+    class PreviewIntegrator : public Integrator {
+    public:
+        virtual Color Integrate(const Scene& scene, const Ray& ray,
+            const Hit* hit, const Color& sky_color, Sampler& sampler)
+            const override;
+    };
+
+    // The state of a path between its bounces.
+    struct PathState {
+        Vec3    Radiance     = Vec3(0.0f);
+        Vec3    Throughput   = Vec3(1.0f);
+        // The density of the direction of the last bounce and the normal it
+        // left from, for weighing the light it finds against sampling the
+        // lights directly
+        Float32 BouncePdf    = 0.0f;
+        Vec3    BounceNormal = Vec3(0.0f);
+        UInt32  Depth        = 0u;
+    };
+
+    // A ray towards a point on a light that adds its radiance to a path if
+    // nothing blocks it.
+    struct ShadowRay {
+        beam::Ray Ray;
+        Float32   Distance;
+        Vec3      Radiance;
+    };
+
+    // Unidirectional path tracing: paths bounce off diffuse surfaces in
+    // cosine weighted random directions and collect the light emitted by
+    // the surfaces and the sky along the way. At every bounce, one of the
+    // lights of the scene that is likely to light the surface is also
+    // sampled directly with a shadow ray, and the two ways of finding light
+    // are combined with multiple importance sampling.
+    class PathIntegrator : public Integrator {
+    public:
+        // Paths end after max_depth bounces. From roulette_depth bounces on,
+        // they are ended at random with a probability that grows as less of
+        // their light can reach the camera (Russian roulette).
+        PathIntegrator(UInt32 max_depth = 8u, UInt32 roulette_depth = 3u)
+            : m_max_depth(max_depth), m_roulette_depth(roulette_depth) { }
+
+        virtual Color Integrate(const Scene& scene, const Ray& ray,
+            const Hit* hit, const Color& sky_color, Sampler& sampler)
+            const override;
+
+        // The steps of Integrate, for tracing many paths in stages. Shade
+        // adds the light that the path finds at its hit and returns a
+        // sample of a light as a shadow ray in shadow. It then replaces the
+        // ray with the next one of the path, or returns false if the path
+        // ends there. Miss adds the light of a ray that left the scene.
+        bool Shade(const Scene& scene, Ray& ray, const Hit& hit,
+            PathState& path, Sampler& sampler,
+            std::optional<ShadowRay>& shadow) const;
+        inline void Miss(PathState& path, const Color& sky_color) const {
+            path.Radiance += path.Throughput * Vec3(sky_color);
+        }
+    private:
+        UInt32 m_max_depth;
+        UInt32 m_roulette_depth;
+    };
+
+}
@@ -0,0 +1,583 @@
+#include "Common.hpp"
+#include "Lights.hpp"
+
+namespace beam {
+
+    // AliasTable
+
+    AliasTable::AliasTable(const std::vector<Float32>& weights)
+        : m_probabilities(weights.size())
+        , m_thresholds(weights.size())
+        , m_aliases(weights.size())
+    {
+        const UCount count = weights.size();
+        const Float64 total =
+            std::accumulate(weights.begin(), weights.end(), 0.0);
+        BEAM_DEBUG_ONLY {
+            if (!(total > 0.0))
+                throw std::runtime_error("Alias table weights are all zero.");
+        }
+
+        // Scale the weights so that they average to one, then fill every
+        // slot that is below one with the excess of one that is above
+        std::vector<Float64> scaled(count);
+        std::vector<UInt32>  small, large;
+        for (UIndex i = 0u; i < count; i++) {
+            m_probabilities[i] = Float32(weights[i] / total);
+            scaled[i]          = weights[i] / total * Float64(count);
+            (scaled[i] < 1.0 ? small : large).push_back(UInt32(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            const UInt32 below = small.back();
+            const UInt32 above = large.back();
+            small.pop_back();
+            m_thresholds[below] = Float32(scaled[below]);
+            m_aliases[below]    = above;
+            scaled[above]      -= 1.0 - scaled[below];
+            if (scaled[above] < 1.0) {
+                large.pop_back();
+                small.push_back(above);
+            }
+        }
+        // What is left is one up to rounding
+        for (const UInt32 i : small) {
+            m_thresholds[i] = 1.0f;
+            m_aliases[i]    = i;
+        }
+        for (const UInt32 i : large) {
+            m_thresholds[i] = 1.0f;
+            m_aliases[i]    = i;
+        }
+    }
+
+    UIndex AliasTable::Sample(Float32 u) const {
+        const Float64 scaled = Float64(u) * Float64(m_thresholds.size());
+        const UIndex  slot   =
+            std::min(UIndex(scaled), m_thresholds.size() - 1u);
+        return Float32(scaled - Float64(slot)) < m_thresholds[slot]
+            ? slot
+            : m_aliases[slot];
+    }
+
+    // Light
+
+    Light Light::MakeSphere(const Vec3& center, Float32 radius,
+            const Vec3& radiance) {
+        Light light;
+        light.Shape    = LightShape::Sphere;
+        light.Position = center;
+        light.EdgeB    = Vec3(0.0f);
+        light.EdgeC    = Vec3(0.0f);
+        light.Radius   = radius;
+        light.Radiance = radiance;
+        return light;
+    }
+
+    Light Light::MakeTriangle(const Vec3& a, const Vec3& b, const Vec3& c,
+            const Vec3& radiance) {
+        Light light;
+        light.Shape    = LightShape::Triangle;
+        light.Position = a;
+        light.EdgeB    = b - a;
+        light.EdgeC    = c - a;
+        light.Radius   = 0.0f;
+        light.Radiance = radiance;
+        return light;
+    }
+
+    Float32 Light::GetArea() const {
+        if (Shape == LightShape::Sphere)
+            return 4.0f * glm::pi<Float32>() * Radius * Radius;
+        return 0.5f * glm::length(glm::cross(EdgeB, EdgeC));
+    }
+
+    Float32 Light::GetPower() const {
+        // Radiance that is the same in every direction integrates to pi
+        // times itself over the hemisphere. Triangles emit from both sides.
+        const Float32 sides = Shape == LightShape::Triangle ? 2.0f : 1.0f;
+        return sides * glm::pi<Float32>() * GetArea()
+            * get_luminance(Color(Radiance, 1.0f));
+    }
+
+    // LightBounds
+
+    // The cosine and sine of the difference of two angles given by their
+    // cosines and sines, where differences below zero count as zero.
+    static inline Float32 cos_difference(Float32 sin_a, Float32 cos_a,
+            Float32 sin_b, Float32 cos_b) {
+        if (cos_a > cos_b)
+            return 1.0f;
+        return cos_a * cos_b + sin_a * sin_b;
+    }
+
+    static inline Float32 sin_difference(Float32 sin_a, Float32 cos_a,
+            Float32 sin_b, Float32 cos_b) {
+        if (cos_a > cos_b)
+            return 0.0f;
+        return sin_a * cos_b - cos_a * sin_b;
+    }
+
+    static inline Float32 get_sine(Float32 cosine) {
+        return std::sqrt(std::max(0.0f, 1.0f - cosine * cosine));
+    }
+
+    static inline Float32 get_angle(Float32 cosine) {
+        return std::acos(std::clamp(cosine, -1.0f, 1.0f));
+    }
+
+    // Rotates v by the angle around the unit axis (Rodrigues' formula).
+    static inline Vec3 rotate(const Vec3& v, const Vec3& axis, Float32 angle) {
+        const Float32
+            c = std::cos(angle),
+            s = std::sin(angle);
+        return v * c + glm::cross(axis, v) * s
+            + axis * glm::dot(axis, v) * (1.0f - c);
+    }
+
+    LightBounds LightBounds::FromLight(const Light& light) {
+        LightBounds bounds;
+        bounds.Power = light.GetPower();
+        if (light.Shape == LightShape::Sphere) {
+            const Vec3 min = light.Position - Vec3(light.Radius);
+            const Vec3 max = light.Position + Vec3(light.Radius);
+            bounds.Bounds = AABB(min.x, max.x, min.y, max.y, min.z, max.z);
+            // The normals of a sphere point everywhere
+            bounds.CosSpread   = -1.0f;
+            bounds.CosEmission = 0.0f;
+            return bounds;
+        }
+        bounds.Bounds.Combine(light.Position);
+        bounds.Bounds.Combine(light.Position + light.EdgeB);
+        bounds.Bounds.Combine(light.Position + light.EdgeC);
+        bounds.Axis        =
+            glm::normalize(glm::cross(light.EdgeB, light.EdgeC));
+        bounds.CosSpread   = 1.0f;
+        bounds.CosEmission = 0.0f;
+        bounds.TwoSided    = true;
+        return bounds;
+    }
+
+    void LightBounds::Combine(const LightBounds& bounds) {
+        if (!(bounds.Power > 0.0f))
+            return;
+        if (!(Power > 0.0f)) {
+            *this = bounds;
+            return;
+        }
+        Bounds.Combine(bounds.Bounds);
+        Power      += bounds.Power;
+        TwoSided    = TwoSided || bounds.TwoSided;
+        CosEmission = std::min(CosEmission, bounds.CosEmission);
+
+        // The smallest cone around both cones of normals
+        const Float32
+            angle_a = get_angle(CosSpread),
+            angle_b = get_angle(bounds.CosSpread),
+            between = get_angle(glm::dot(Axis, bounds.Axis));
+        if (std::min(between + angle_b, glm::pi<Float32>()) <= angle_a)
+            return;
+        if (std::min(between + angle_a, glm::pi<Float32>()) <= angle_b) {
+            Axis      = bounds.Axis;
+            CosSpread = bounds.CosSpread;
+            return;
+        }
+        const Float32 angle = 0.5f * (angle_a + between + angle_b);
+        const Vec3    cross = glm::cross(Axis, bounds.Axis);
+        if (angle >= glm::pi<Float32>() || !(glm::length2(cross) > 0.0f)) {
+            CosSpread = -1.0f;
+            return;
+        }
+        Axis      = rotate(Axis, glm::normalize(cross), angle - angle_a);
+        CosSpread = std::cos(angle);
+    }
+
+    Float32 LightBounds::GetImportance(const Vec3& point,
+            const Vec3& normal) const {
+        if (!(Power > 0.0f))
+            return 0.0f;
+        const Vec3    center      = Bounds.GetCenter();
+        const Vec3    diagonal    = Bounds.GetMax() - Bounds.GetMin();
+        const Vec3    to_point    = point - center;
+        const Float32 distance_sq = glm::length2(to_point);
+        const Float32 radius_sq   = 0.25f * glm::length2(diagonal);
+        const Vec3    direction   = distance_sq > 0.0f
+            ? to_point / std::sqrt(distance_sq)
+            : Vec3(0.0f, 0.0f, 1.0f);
+
+        // The angle between the axis and the direction to the point, and
+        // the half angle of the cone of directions from the point that
+        // contains the bounds. Inside their bounding sphere, the lights
+        // might be in any direction.
+        Float32 cos_direction = glm::dot(Axis, direction);
+        if (TwoSided)
+            cos_direction = std::abs(cos_direction);
+        const Float32
+            sin_direction = get_sine(cos_direction),
+            cos_bounds    = distance_sq > radius_sq
+                ? std::sqrt(1.0f - radius_sq / distance_sq)
+                : -1.0f,
+            sin_bounds    = get_sine(cos_bounds),
+            sin_spread    = get_sine(CosSpread);
+
+        // The smallest angle between a normal of the lights and a direction
+        // from the lights to the point, which needs to be within the angle
+        // of emission
+        const Float32
+            cos_outside = cos_difference(sin_direction, cos_direction,
+                sin_spread, CosSpread),
+            sin_outside = sin_difference(sin_direction, cos_direction,
+                sin_spread, CosSpread),
+            cos_closest = cos_difference(sin_outside, cos_outside,
+                sin_bounds, cos_bounds);
+        if (cos_closest <= CosEmission)
+            return 0.0f;
+
+        // The smallest angle between the normal at the point and a
+        // direction towards the lights
+        const Float32
+            cos_incident = -glm::dot(normal, direction),
+            cos_surface  = cos_difference(get_sine(cos_incident),
+                cos_incident, sin_bounds, cos_bounds);
+        if (!(cos_surface > 0.0f))
+            return 0.0f;
+        // Lights that the point is close to are not favored beyond the
+        // size of their bounds
+        return Power * cos_closest * cos_surface
+            / std::max(distance_sq, radius_sq);
+    }
+
+    // LightSampler
+
+    // Converts the density of a point picked uniformly on the part of the
+    // light that faces the shading point from area to solid angle.
+    static Float32 get_area_pdf(const Light& light, const Vec3& point,
+            const Vec3& light_point, const Vec3& light_normal) {
+        Float32 area = light.GetArea();
+        if (light.Shape == LightShape::Sphere) {
+            if (glm::length2(point - light.Position)
+                    <= light.Radius * light.Radius)
+                return 0.0f;
+            area *= 0.5f;
+        }
+        const Vec3    offset      = light_point - point;
+        const Float32 distance_sq = glm::dot(offset, offset);
+        const Float32 cosine      = std::abs(glm::dot(light_normal, offset))
+            / std::sqrt(distance_sq);
+        if (!(cosine > 0.0f))
+            return 0.0f;
+        return distance_sq / (cosine * area);
+    }
+
+    bool LightSampler::Add(const Light& light) {
+        if (!(light.GetPower() > 0.0f))
+            return false;
+        m_lights.push_back(light);
+        return true;
+    }
+
+    void LightSampler::Clear() {
+        m_lights.clear();
+    }
+
+    std::optional<LightSample> LightSampler::Sample(const Vec3& point,
+            const Vec3& normal, Float32 u, const Vec2& uv) const {
+        if (IsEmpty())
+            return std::nullopt;
+        UIndex index;
+        const Float32 probability = Pick(point, normal, u, index);
+        if (!(probability > 0.0f))
+            return std::nullopt;
+        const Light& light = m_lights[index];
+
+        const Float32
+            s = uv.x,
+            t = uv.y;
+        Vec3 light_point, light_normal;
+        if (light.Shape == LightShape::Sphere) {
+            // A uniform point on the hemisphere that faces the point
+            const Vec3 to_point = point - light.Position;
+            if (glm::length2(to_point) <= light.Radius * light.Radius)
+                return std::nullopt;
+            const Vec3 axis = glm::normalize(to_point);
+            const auto [tangent, bitangent] = get_tangents(axis);
+            const Float32
+                z   = s,
+                r   = std::sqrt(std::max(0.0f, 1.0f - z * z)),
+                phi = glm::two_pi<Float32>() * t;
+            light_normal = r * std::cos(phi) * tangent
+                + r * std::sin(phi) * bitangent + z * axis;
+            light_point  = light.Position + light.Radius * light_normal;
+        } else {
+            // Uniform barycentric coordinates
+            const Float32 root = std::sqrt(s);
+            light_point  = light.Position + root * (1.0f - t) * light.EdgeB
+                + root * t * light.EdgeC;
+            light_normal =
+                glm::normalize(glm::cross(light.EdgeB, light.EdgeC));
+        }
+
+        const Vec3    offset   = light_point - point;
+        const Float32 distance = glm::length(offset);
+        if (!(distance > 0.0f))
+            return std::nullopt;
+        LightSample sample;
+        sample.Direction = offset / distance;
+        sample.Distance  = distance;
+        sample.Radiance  = light.Radiance;
+        sample.Pdf       = probability
+            * get_area_pdf(light, point, light_point, light_normal);
+        if (!(sample.Pdf > 0.0f))
+            return std::nullopt;
+        return sample;
+    }
+
+    Float32 LightSampler::GetPdf(UIndex light, const Vec3& point,
+            const Vec3& normal, const Vec3& light_point,
+            const Vec3& light_normal) const {
+        const Float32 probability = GetProbability(light, point, normal);
+        if (!(probability > 0.0f))
+            return 0.0f;
+        return probability
+            * get_area_pdf(m_lights[light], point, light_point, light_normal);
+    }
+
+    // LightTable
+
+    void LightTable::Build() {
+        if (m_lights.empty()) {
+            m_table = AliasTable();
+            return;
+        }
+        std::vector<Float32> powers;
+        powers.reserve(m_lights.size());
+        for (const Light& light : m_lights)
+            powers.push_back(light.GetPower());
+        m_table = AliasTable(powers);
+    }
+
+    void LightTable::Clear() {
+        LightSampler::Clear();
+        m_table = AliasTable();
+    }
+
+    void LightTable::PrintStats(std::ostream& out) const {
+        out << "Light table: " << m_lights.size() << " lights" << std::endl;
+    }
+
+    Float32 LightTable::Pick(const Vec3&, const Vec3&, Float32 u,
+            UIndex& light) const {
+        light = m_table.Sample(u);
+        return m_table.GetProbability(light);
+    }
+
+    Float32 LightTable::GetProbability(UIndex light, const Vec3&,
+            const Vec3&) const {
+        return m_table.GetProbability(light);
+    }
+
+    // LightTree
+
+    // The number of buckets per axis that the lights of a node are sorted
+    // into by their centers to look for the best split
+    static constexpr UCount BucketCount = 12u;
+
+    // The cost of splitting off the lights with the given bounds according
+    // to the surface area orientation heuristic: the power of the lights
+    // times the measure of their bounding cone times their surface area. The
+    // regularization factor penalizes splits along thin sides of the node.
+    static Float32 get_split_cost(const LightBounds& bounds,
+            Float32 regularization) {
+        if (!(bounds.Power > 0.0f))
+            return 0.0f;
+        const Float32
+            pi          = glm::pi<Float32>(),
+            angle       = get_angle(bounds.CosSpread),
+            emission    = std::min(angle + get_angle(bounds.CosEmission), pi),
+            sin_spread  = get_sine(bounds.CosSpread),
+            orientation = 2.0f * pi * (1.0f - bounds.CosSpread)
+                + 0.5f * pi * (2.0f * emission * sin_spread
+                    - std::cos(angle - 2.0f * emission)
+                    - 2.0f * angle * sin_spread + bounds.CosSpread);
+        return bounds.Power * orientation * regularization
+            * bounds.Bounds.GetSurfaceArea();
+    }
+
+    void LightTree::Build() {
+        m_nodes.clear();
+        m_trails.assign(m_lights.size(), 0u);
+        if (m_lights.empty())
+            return;
+        std::vector<std::pair<UInt32, LightBounds>> lights;
+        lights.reserve(m_lights.size());
+        for (UIndex i = 0u; i < m_lights.size(); i++)
+            lights.emplace_back(UInt32(i), LightBounds::FromLight(m_lights[i]));
+        m_nodes.reserve(2u * m_lights.size() - 1u);
+        BuildNode(lights, 0u, lights.size(), 0u, 0u);
+    }
+
+    UInt32 LightTree::BuildNode(
+            std::vector<std::pair<UInt32, LightBounds>>& lights, UIndex begin,
+            UIndex end, UInt64 trail, UCount depth) {
+        const UInt32 index = UInt32(m_nodes.size());
+        m_nodes.emplace_back();
+        if (end - begin == 1u) {
+            const auto& [light, bounds] = lights[begin];
+            m_nodes[index] = { bounds, light, true };
+            m_trails[light] = trail;
+            return index;
+        }
+
+        LightBounds bounds;
+        AABB        centers = AABB::Nothing();
+        for (UIndex i = begin; i < end; i++) {
+            bounds.Combine(lights[i].second);
+            centers.Combine(lights[i].second.Bounds.GetCenter());
+        }
+
+        // Sort the lights into buckets on every axis and split between the
+        // buckets where the heuristic is lowest. Deep in the tree, the
+        // lights are split in half instead, so that no trail runs out of
+        // bits.
+        const Vec3 min    = centers.GetMin();
+        const Vec3 extent = centers.GetMax() - min;
+        const Vec3 size   = bounds.Bounds.GetMax() - bounds.Bounds.GetMin();
+        const Float32 max_size = std::max(size.x, std::max(size.y, size.z));
+        const auto get_bucket = [&](const LightBounds& light, UIndex axis) {
+            const Float32 offset = light.Bounds.GetCenter()[axis] - min[axis];
+            return std::min(UIndex(Float32(BucketCount) * offset
+                / extent[axis]), BucketCount - 1u);
+        };
+        Float32 best_cost   = std::numeric_limits<Float32>::infinity();
+        UIndex  best_axis   = 0u;
+        UIndex  best_bucket = 0u;
+        for (UIndex axis = 0u; axis < 3u && depth < MaxDepth / 2u; axis++) {
+            if (!(extent[axis] > 0.0f))
+                continue;
+            std::array<LightBounds, BucketCount> buckets;
+            for (UIndex i = begin; i < end; i++)
+                buckets[get_bucket(lights[i].second, axis)]
+                    .Combine(lights[i].second);
+            std::array<LightBounds, BucketCount> right;
+            for (UIndex bucket = BucketCount - 1u; bucket > 0u; bucket--) {
+                right[bucket - 1u] = right[bucket];
+                right[bucket - 1u].Combine(buckets[bucket]);
+            }
+            const Float32 regularization = max_size / size[axis];
+            LightBounds left;
+            for (UIndex bucket = 0u; bucket + 1u < BucketCount; bucket++) {
+                left.Combine(buckets[bucket]);
+                if (!(left.Power > 0.0f) || !(right[bucket].Power > 0.0f))
+                    continue;
+                const Float32 cost = get_split_cost(left, regularization)
+                    + get_split_cost(right[bucket], regularization);
+                if (cost < best_cost) {
+                    best_cost   = cost;
+                    best_axis   = axis;
+                    best_bucket = bucket;
+                }
+            }
+        }
+
+        UIndex middle;
+        if (best_cost < std::numeric_limits<Float32>::infinity()) {
+            middle = std::partition(lights.begin() + begin,
+                lights.begin() + end,
+                [&](const std::pair<UInt32, LightBounds>& light) {
+                    return get_bucket(light.second, best_axis) <= best_bucket;
+                }) - lights.begin();
+        } else {
+            const UIndex axis = extent.x > extent.y
+                ? (extent.x > extent.z ? 0u : 2u)
+                : (extent.y > extent.z ? 1u : 2u);
+            middle = begin + (end - begin) / 2u;
+            std::nth_element(lights.begin() + begin, lights.begin() + middle,
+                lights.begin() + end,
+                [&](const std::pair<UInt32, LightBounds>& a,
+                        const std::pair<UInt32, LightBounds>& b) {
+                    return a.second.Bounds.GetCenter()[axis]
+                        < b.second.Bounds.GetCenter()[axis];
+                });
+        }
+
+        BuildNode(lights, begin, middle, trail, depth + 1u);
+        const UInt32 second = BuildNode(lights, middle, end,
+            trail | (UInt64(1u) << depth), depth + 1u);
+        m_nodes[index] = { bounds, second, false };
+        return index;
+    }
+
+    void LightTree::Clear() {
+        LightSampler::Clear();
+        m_nodes.clear();
+        m_trails.clear();
+    }
+
+    std::optional<Float32> LightTree::GetFirstChildProbability(
+            const Node& node, const Vec3& point, const Vec3& normal) const {
+        const Node* first = &node + 1;
+        const Float32
+            a = first->Bounds.GetImportance(point, normal),
+            b = m_nodes[node.Offset].Bounds.GetImportance(point, normal);
+        if (!(a + b > 0.0f))
+            return std::nullopt;
+        return a / (a + b);
+    }
+
+    Float32 LightTree::Pick(const Vec3& point, const Vec3& normal,
+            Float32 u, UIndex& light) const {
+        // Walk down the tree, reusing the random number for every choice
+        // by stretching the part of it that was chosen back to [0, 1)
+        constexpr Float32 max_u =
+            1.0f - std::numeric_limits<Float32>::epsilon();
+        Float32 probability = 1.0f;
+        UIndex  index       = 0u;
+        while (!m_nodes[index].Leaf) {
+            const Node& node  = m_nodes[index];
+            const auto  first =
+                GetFirstChildProbability(node, point, normal);
+            if (!first)
+                return 0.0f;
+            if (u < *first) {
+                u            = std::min(u / *first, max_u);
+                probability *= *first;
+                index       += 1u;
+            } else {
+                u            = std::min((u - *first) / (1.0f - *first), max_u);
+                probability *= 1.0f - *first;
+                index        = node.Offset;
+            }
+        }
+        light = m_nodes[index].Offset;
+        return probability;
+    }
+
+    Float32 LightTree::GetProbability(UIndex light, const Vec3& point,
+            const Vec3& normal) const {
+        // Follow the trail of the light down the tree
+        UInt64  trail       = m_trails[light];
+        Float32 probability = 1.0f;
+        UIndex  index       = 0u;
+        while (!m_nodes[index].Leaf) {
+            const Node& node  = m_nodes[index];
+            const auto  first =
+                GetFirstChildProbability(node, point, normal);
+            if (!first)
+                return 0.0f;
+            if (trail & 1u) {
+                probability *= 1.0f - *first;
+                index        = node.Offset;
+            } else {
+                probability *= *first;
+                index       += 1u;
+            }
+            trail >>= 1u;
+        }
+        return probability;
+    }
+
+    void LightTree::PrintStats(std::ostream& out) const {
+        out << "Light tree: " << m_lights.size() << " lights, "
+            << m_nodes.size() << " nodes" << std::endl;
+    }
+
+}
@@ -0,0 +1,209 @@
+#pragma once
+#include "raytracing/AABB.hpp"
+
+namespace beam {
+
+    // Picks one of a fixed set of items with probability proportional to
+    // its weight in constant time (Vose's alias method).
+    class AliasTable {
+    public:
+        AliasTable() { }
+        // The weights must not be negative, and at least one of them has to
+        // be positive.
+        explicit AliasTable(const std::vector<Float32>& weights);
+
+        inline bool   IsEmpty()  const { return m_probabilities.empty(); }
+        inline UCount GetCount() const { return m_probabilities.size(); }
+
+        // Returns the index of an item for a uniform random number in
+        // [0, 1).
+        UIndex Sample(Float32 u) const;
+        inline Float32 GetProbability(UIndex i) const {
+            return m_probabilities[i];
+        }
+    private:
+        std::vector<Float32> m_probabilities;
+        // The item is picked if the fraction within its slot is below its
+        // threshold, and its alias otherwise.
+        std::vector<Float32> m_thresholds;
+        std::vector<UInt32>  m_aliases;
+    };
+
+    enum class LightShape : UInt8 {
+        Sphere,
+        Triangle,
+    };
+
+    // An emissive primitive in world space. Lights emit the same radiance in
+    // every direction from both sides of their surface, like diffuse
+    // emitters.
+    struct Light {
+        LightShape Shape;
+        // The center of a sphere, or the first vertex of a triangle
+        Vec3       Position;
+        // The edges of a triangle leaving its first vertex
+        Vec3       EdgeB;
+        Vec3       EdgeC;
+        Float32    Radius;
+        Vec3       Radiance;
+
+        static Light MakeSphere(const Vec3& center, Float32 radius,
+            const Vec3& radiance);
+        static Light MakeTriangle(const Vec3& a, const Vec3& b, const Vec3& c,
+            const Vec3& radiance);
+
+        Float32 GetArea() const;
+        // The total emitted power, by luminance
+        Float32 GetPower() const;
+    };
+
+    // A light sample as seen from a shading point
+    struct LightSample {
+        // Normalized direction from the shading point to the light
+        Vec3    Direction;
+        Float32 Distance;
+        Vec3    Radiance;
+        // The density of the sample in solid angle at the shading point,
+        // including the probability of picking the light
+        Float32 Pdf;
+    };
+
+    // Bounds on where a group of lights is, which way they face and how
+    // much power they emit, to estimate how much light they send to a
+    // point (Conty Estevez and Kulla, "Importance Sampling of Many Lights
+    // with Adaptive Tree Splitting", 2018).
+    struct LightBounds {
+        AABB    Bounds = AABB::Nothing();
+        // The normals of the lights lie within CosSpread of Axis, and they
+        // emit up to CosEmission away from their normals
+        Vec3    Axis        = Vec3(0.0f, 0.0f, 1.0f);
+        Float32 CosSpread   = 1.0f;
+        Float32 CosEmission = 1.0f;
+        // Zero for bounds that contain no lights, since lights without
+        // power are never added
+        Float32 Power       = 0.0f;
+        // Whether the lights also emit against their normals
+        bool    TwoSided    = false;
+
+        static LightBounds FromLight(const Light& light);
+
+        void Combine(const LightBounds& bounds);
+        // A conservative estimate of the light that reaches the point on a
+        // surface with the given normal, up to a constant factor. Zero
+        // means that none of the lights can light the point.
+        Float32 GetImportance(const Vec3& point, const Vec3& normal) const;
+    };
+
+    // The emissive primitives of a scene, for sampling light directly. A
+    // light is picked by one of the strategies below, and a point is then
+    // picked uniformly on the part of the light that faces the shading
+    // point: the whole of a triangle, or the hemisphere of a sphere.
+    class LightSampler {
+    public:
+        virtual ~LightSampler() { }
+
+        // Lights without power are left out; returns whether the light was
+        // added.
+        bool Add(const Light& light);
+        // Needs to be called after lights were added.
+        virtual void Build() = 0;
+        virtual void Clear();
+
+        inline bool IsEmpty() const { return m_lights.empty(); }
+        inline const std::vector<Light>& GetLights() const { return m_lights; }
+
+        // Picks a light with u and a point on it with uv, which are uniform
+        // in [0, 1). Returns std::nullopt if no light can reach the point
+        // on a surface with the given normal or the point is inside the
+        // light that was picked.
+        std::optional<LightSample> Sample(const Vec3& point,
+            const Vec3& normal, Float32 u, const Vec2& uv) const;
+        // Returns the density in solid angle with which Sample picks the
+        // given point on a light from the shading point, or zero if it
+        // never does.
+        Float32 GetPdf(UIndex light, const Vec3& point, const Vec3& normal,
+            const Vec3& light_point, const Vec3& light_normal) const;
+
+        // Writes the number of lights and the size of the structure that
+        // picks them.
+        virtual void PrintStats(std::ostream& out) const = 0;
+    protected:
+        std::vector<Light> m_lights;
+
+        // Picks a light for the shading point with u and returns the
+        // probability of having picked it, or zero if no light was picked.
+        virtual Float32 Pick(const Vec3& point, const Vec3& normal, Float32 u,
+            UIndex& light) const = 0;
+        // The probability with which Pick picks the light.
+        virtual Float32 GetProbability(UIndex light, const Vec3& point,
+            const Vec3& normal) const = 0;
+    };
+
+    // Picks lights with probability proportional to their power, no matter
+    // where the shading point is. Picking takes constant time, but with
+    // many lights most samples go to lights that are far away or face the
+    // other way.
+    class LightTable : public LightSampler {
+    public:
+        virtual void Build() override;
+        virtual void Clear() override;
+
+        virtual void PrintStats(std::ostream& out) const override;
+    protected:
+        virtual Float32 Pick(const Vec3& point, const Vec3& normal, Float32 u,
+            UIndex& light) const override;
+        virtual Float32 GetProbability(UIndex light, const Vec3& point,
+            const Vec3& normal) const override;
+    private:
+        AliasTable m_table;
+    };
+
+    // Organizes the lights in a binary tree whose nodes bound the position,
+    // orientation and power of the lights below them. A light is picked by
+    // walking down the tree and choosing each child with probability
+    // proportional to its estimated contribution at the shading point, so
+    // lights that are far away or face the other way are rarely picked no
+    // matter how many there are. Every choice costs two estimates, which
+    // makes picking slower than with a LightTable in scenes with few
+    // lights.
+    class LightTree : public LightSampler {
+    public:
+        // Every light has a trail of bits through the tree, one per level.
+        static constexpr UCount MaxDepth = 64u;
+
+        virtual void Build() override;
+        virtual void Clear() override;
+
+        inline UCount GetNodeCount() const { return m_nodes.size(); }
+
+        virtual void PrintStats(std::ostream& out) const override;
+    protected:
+        virtual Float32 Pick(const Vec3& point, const Vec3& normal, Float32 u,
+            UIndex& light) const override;
+        virtual Float32 GetProbability(UIndex light, const Vec3& point,
+            const Vec3& normal) const override;
+    private:
+        struct Node {
+            LightBounds Bounds;
+            // For a leaf, the index of its light; for an interior node, the
+            // index of its second child. The first child of an interior
+            // node always directly follows it.
+            UInt32      Offset;
+            bool        Leaf;
+        };
+
+        std::vector<Node>   m_nodes;
+        // For every light, the child taken at each level on the way to its
+        // leaf, starting from the lowest bit: zero for the first child and
+        // one for the second.
+        std::vector<UInt64> m_trails;
+
+        UInt32 BuildNode(std::vector<std::pair<UInt32, LightBounds>>& lights,
+            UIndex begin, UIndex end, UInt64 trail, UCount depth);
+        // Returns the probability of picking the first child of the node,
+        // or std::nullopt if neither child can light the point.
+        std::optional<Float32> GetFirstChildProbability(const Node& node,
+            const Vec3& point, const Vec3& normal) const;
+    };
+
+}
@@ -0,0 +1,111 @@
+#include "Common.hpp"
+#include "Mesh.hpp"
+
+namespace beam {
+
+    Mesh::Mesh(const beam::Material& material, std::vector<Vec3> vertices,
+            std::vector<UInt32> indices, ThreadPool* pool)
+        : Material(material)
+        , m_vertices(std::move(vertices))
+        , m_indices(std::move(indices))
+        , m_bounds(AABB::Nothing())
+    {
+        if (m_indices.size() % 3u != 0u)
+            throw std::runtime_error(
+                "Mesh index count is not a multiple of three."
+            );
+        for (const UInt32 index : m_indices)
+            if (index >= m_vertices.size())
+                throw std::runtime_error("Mesh vertex index out of range.");
+
+        UIndex kept = 0u;
+        for (UIndex i = 0u; i < GetTriangleCount(); i++) {
+            const Vec3&
+                A = m_vertices[m_indices[3u * i]],
+                B = m_vertices[m_indices[3u * i + 1u]],
+                C = m_vertices[m_indices[3u * i + 2u]];
+            const Vec3 normal = glm::cross(B - A, C - A);
+            if (!(glm::dot(normal, normal) > 0.0f))
+                continue;
+            for (UIndex j = 0u; j < 3u; j++)
+                m_indices[3u * kept + j] = m_indices[3u * i + j];
+            kept++;
+        }
+        m_indices.resize(3u * kept);
+        // A mesh without triangles would have empty bounds, which the
+        // hierarchies above it can't sort into their bins
+        if (m_indices.empty())
+            throw std::runtime_error("Mesh has no triangles.");
+        Build(pool);
+    }
+
+    void Mesh::Refit(ThreadPool* pool, Float32 rebuild_threshold) {
+        m_bvh.Refit(UpdateBounds());
+        const BVH::Stats& stats = m_bvh.GetStats();
+        if (stats.Cost > rebuild_threshold * stats.BuildCost)
+            Build(pool);
+    }
+
+    std::vector<AABB> Mesh::UpdateBounds() {
+        std::vector<AABB> bounds;
+        bounds.reserve(GetTriangleCount());
+        m_bounds = AABB::Nothing();
+        for (UIndex i = 0u; i < GetTriangleCount(); i++) {
+            AABB aabb = AABB::Nothing();
+            for (UIndex j = 0u; j < 3u; j++)
+                aabb.Combine(m_vertices[m_indices[3u * i + j]]);
+            bounds.push_back(aabb);
+            m_bounds.Combine(aabb);
+        }
+        return bounds;
+    }
+
+    void Mesh::Build(ThreadPool* pool) {
+        m_bvh.Build(UpdateBounds(), pool);
+
+        // Put the triangles in BVH order, so that every leaf refers to a
+        // contiguous range of them.
+        std::vector<UInt32> indices_in_order;
+        indices_in_order.reserve(m_indices.size());
+        for (const UInt32 triangle : m_bvh.GetIndices())
+            for (UIndex j = 0u; j < 3u; j++)
+                indices_in_order.push_back(m_indices[3u * triangle + j]);
+        m_indices = std::move(indices_in_order);
+    }
+
+    AABB Mesh::GetBoundingBox() const {
+        return m_bounds;
+    }
+
+    bool Mesh::Intersect(const Ray& ray, Hit& hit) const {
+        bool found = false;
+        m_bvh.Traverse(ray, hit.Distance, [&](UInt32 first, UInt32 count) {
+            for (UIndex i = first; i < first + count; i++)
+                found |= IntersectTriangle(i, ray, hit);
+        });
+        return found;
+    }
+
+    bool Mesh::Intersects(const Ray& ray, Float32 t_max) const {
+        Hit hit(t_max);
+        return m_bvh.TraverseAny(ray, t_max, [&](UInt32 first, UInt32 count) {
+            for (UIndex i = first; i < first + count; i++)
+                if (IntersectTriangle(i, ray, hit))
+                    return true;
+            return false;
+        });
+    }
+
+    Intersection Mesh::GetIntersection(const Ray& ray, const Hit& hit) const {
+        const Vec3&
+            A = m_vertices[m_indices[3u * hit.Primitive]],
+            B = m_vertices[m_indices[3u * hit.Primitive + 1u]],
+            C = m_vertices[m_indices[3u * hit.Primitive + 2u]];
+        return Intersection(
+            ray.Traverse(hit.Distance),
+            glm::normalize(glm::cross(B - A, C - A)),
+            Material
+        );
+    }
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "raytracing/Raytracing.hpp"
+#include "raytracing/AABB.hpp"
+#include "raytracing/BVH.hpp"
+
+namespace beam {
+
+    // A triangle mesh stored as a shared vertex buffer and three vertex
+    // indices per triangle, with one material for the whole mesh. Meshes
+    // have their own BVH over their triangles, which is built when the mesh
+    // is created.
+    class Mesh : public Intersectable {
+    public:
+        Material Material;
+
+        // Triangles without an area are left out, since they have no
+        // normal. Throws std::runtime_error if the number of indices isn't
+        // a multiple of three, an index is out of range or no triangles
+        // are left. The BVH is built in parallel if a thread pool is given.
+        Mesh(const beam::Material& material, std::vector<Vec3> vertices,
+            std::vector<UInt32> indices, ThreadPool* pool = nullptr);
+
+        inline const std::vector<Vec3>&   GetVertices() const {
+            return m_vertices;
+        }
+        // Refit needs to be called after the vertices changed.
+        inline std::vector<Vec3>&         GetVertices() {
+            return m_vertices;
+        }
+        // Three indices per triangle. The triangles are in BVH order, which
+        // generally differs from the order they were given in.
+        inline const std::vector<UInt32>& GetIndices() const {
+            return m_indices;
+        }
+        inline UCount GetTriangleCount() const {
+            return m_indices.size() / 3u;
+        }
+        inline const BVH& GetBVH() const { return m_bvh; }
+
+        // Updates the BVH after vertices moved, see Scene::Refit.
+        void Refit(ThreadPool* pool = nullptr,
+            Float32 rebuild_threshold = 1.5f);
+
+        virtual AABB GetBoundingBox() const override;
+        using Intersectable::Intersect;
+        // Records the index of the triangle that was hit in hit.Primitive.
+        virtual bool Intersect(const Ray& ray, Hit& hit) const override;
+        virtual Intersection GetIntersection(const Ray& ray, const Hit& hit)
+            const override;
+        using Intersectable::Intersects;
+        virtual bool Intersects(const Ray& ray, Float32 t_max) const override;
+    private:
+        std::vector<Vec3>   m_vertices;
+        std::vector<UInt32> m_indices;
+        BVH                 m_bvh;
+        AABB                m_bounds;
+
+        // Recomputes the bounds of the mesh and returns the bounds of its
+        // triangles.
+        std::vector<AABB> UpdateBounds();
+        void Build(ThreadPool* pool);
+
+        inline bool IntersectTriangle(UIndex i, const Ray& ray, Hit& hit)
+                const {
+            // Möller-Trumbore, see Triangle::Intersect
+            constexpr Float32 epsilon = 1.0e-7f;
+            const Vec3&
+                A  = m_vertices[m_indices[3u * i]];
+            const Vec3
+                AB = m_vertices[m_indices[3u * i + 1u]] - A,
+                AC = m_vertices[m_indices[3u * i + 2u]] - A,
+                h  = glm::cross(ray.Direction, AC);
+            const Float32 a = glm::dot(AB, h);
+            if (-epsilon < a && a < epsilon)
+                return false;
+            const Float32 inv_a = 1.0f / a;
+            const Vec3    AO    = ray.Origin - A;
+            const Float32 u     = inv_a * glm::dot(AO, h);
+            if (u < 0.0f || 1.0f < u)
+                return false;
+            const Vec3    q = glm::cross(AO, AB);
+            const Float32 v = inv_a * glm::dot(ray.Direction, q);
+            if (v < 0.0f || 1.0f < u + v)
+                return false;
+            const Float32 t = inv_a * glm::dot(AC, q);
+            if (!(epsilon < t && t < std::min(hit.Distance, 1.0f / epsilon)))
+                return false;
+            hit.Distance     = t;
+            hit.Primitive    = UInt32(i);
+            hit.Barycentrics = { u, v };
+            return true;
+        }
+    };
+
+}
@@ -1,51 +1,9 @@
 #pragma once
 #include "raytracing/Raytracing.hpp"
-#include "raytracing/Camera.hpp"
-#include "rendering/Color.hpp"
-#include "rendering/Renderer.hpp"
-#include "RNG.hpp"
+#include "raytracing/AABB.hpp"
 
 namespace beam {
 
-    class AABB : public Intersectable {
-    public:
-        Float32 XMin, XMax, YMin, YMax, ZMin, ZMax;
-
-        AABB()
-            : XMin(-std::numeric_limits<Float32>::infinity())
-            , XMax( std::numeric_limits<Float32>::infinity())
-            , YMin(-std::numeric_limits<Float32>::infinity())
-            , YMax( std::numeric_limits<Float32>::infinity())
-            , ZMin(-std::numeric_limits<Float32>::infinity())
-            , ZMax( std::numeric_limits<Float32>::infinity())
-        { }
-        AABB(Float32 x_min, Float32 x_max, Float32 y_min, Float32 y_max,
-                Float32 z_min, Float32 z_max)
-            : XMin(x_min), XMax(x_max), YMin(y_min), YMax(y_max), ZMin(z_min),
-                ZMax(z_max) { }
-
-        virtual AABB GetBoundingBox() const override;
-        virtual std::optional<Intersection> Intersect(const Ray& ray)
-            const override;
-        virtual bool Intersects(const Ray& ray) const override;
-
-        void Combine(const AABB& aabb);
-
-        static AABB OverarchingAABB(const AABB& a, const AABB& b);
-
-        inline static AABB Infinite() { return AABB(); }
-        inline static AABB Nothing() {
-            return AABB(
-                 std::numeric_limits<Float32>::infinity(),
-                -std::numeric_limits<Float32>::infinity(),
-                 std::numeric_limits<Float32>::infinity(),
-                -std::numeric_limits<Float32>::infinity(),
-                 std::numeric_limits<Float32>::infinity(),
-                -std::numeric_limits<Float32>::infinity()
-            );
-        }
-    };
-
     class Sphere : public Intersectable {
     public:
         Vec3     Center;
@@ -57,7 +15,9 @@ namespace beam {
             : Center(center), Radius(radius), Material(material) { }
         
         virtual AABB GetBoundingBox() const override;
-        virtual std::optional<Intersection> Intersect(const Ray& ray)
+        using Intersectable::Intersect;
+        virtual bool Intersect(const Ray& ray, Hit& hit) const override;
+        virtual Intersection GetIntersection(const Ray& ray, const Hit& hit)
             const override;
     };
 
@@ -78,7 +38,9 @@ namespace beam {
         { }
 
         virtual AABB GetBoundingBox() const override;
-        virtual std::optional<Intersection> Intersect(const Ray& ray)
+        using Intersectable::Intersect;
+        virtual bool Intersect(const Ray& ray, Hit& hit) const override;
+        virtual Intersection GetIntersection(const Ray& ray, const Hit& hit)
             const override;
     };
 
@@ -108,7 +70,9 @@ namespace beam {
         }
 
         virtual AABB GetBoundingBox() const override;
-        virtual std::optional<Intersection> Intersect(const Ray& ray)
+        using Intersectable::Intersect;
+        virtual bool Intersect(const Ray& ray, Hit& hit) const override;
+        virtual Intersection GetIntersection(const Ray& ray, const Hit& hit)
             const override;
     private:
         Vec3 m_A, m_B, m_C, m_normal, m_center;
@@ -119,25 +83,4 @@ namespace beam {
         }
     };
 
-    class Scene : public Intersectable {
-    public:
-        Scene() { }
-
-        template <typename IntersectableT, typename... Args>
-        Scene& Add(Args&&... args) {
-            m_objects.emplace_back(std::make_unique<IntersectableT>(args...));
-            return *this;
-        }
-
-        virtual AABB GetBoundingBox() const override;
-        virtual std::optional<Intersection> Intersect(const Ray& ray)
-            const override;
-
-        void Clear();
-        void Trace(const Camera& camera, const Color& sky_color,
-            RNG& rng, PixelBuffer& buffer) const;
-    private:
-        std::vector<std::unique_ptr<Intersectable>> m_objects;
-    };
-
 }
@@ -0,0 +1,239 @@
+#include "Common.hpp"
+#include "PrimitiveArrays.hpp"
+#include "SIMD.hpp"
+
+namespace beam {
+
+    // SphereArray
+
+    void SphereArray::Add(const Sphere& sphere) {
+        CenterX.push_back(sphere.Center.x);
+        CenterY.push_back(sphere.Center.y);
+        CenterZ.push_back(sphere.Center.z);
+        Radius.push_back(sphere.Radius);
+        Materials.push_back(sphere.Material);
+    }
+
+    void SphereArray::Set(UIndex i, const Sphere& sphere) {
+        CenterX[i]   = sphere.Center.x;
+        CenterY[i]   = sphere.Center.y;
+        CenterZ[i]   = sphere.Center.z;
+        Radius[i]    = sphere.Radius;
+        Materials[i] = sphere.Material;
+    }
+
+    void SphereArray::Clear() {
+        CenterX.clear();
+        CenterY.clear();
+        CenterZ.clear();
+        Radius.clear();
+        Materials.clear();
+    }
+
+    void SphereArray::Reorder(const std::vector<UInt32>& order) {
+        reorder(CenterX,   order);
+        reorder(CenterY,   order);
+        reorder(CenterZ,   order);
+        reorder(Radius,    order);
+        reorder(Materials, order);
+    }
+
+    Sphere SphereArray::Get(UIndex i) const {
+        return Sphere(Materials[i], GetCenter(i), Radius[i]);
+    }
+
+    AABB SphereArray::GetBoundingBox(UIndex i) const {
+        return Get(i).GetBoundingBox();
+    }
+
+    Intersection SphereArray::GetIntersection(UIndex i, const Ray& ray,
+            const Hit& hit) const {
+        const auto P = ray.Traverse(hit.Distance);
+        return Intersection(P, (P - GetCenter(i)) / Radius[i], Materials[i]);
+    }
+
+    // PlaneArray
+
+    void PlaneArray::Add(const Plane& plane) {
+        NormalX.push_back(plane.Normal.x);
+        NormalY.push_back(plane.Normal.y);
+        NormalZ.push_back(plane.Normal.z);
+        D.push_back(plane.D);
+        Materials.push_back(plane.Material);
+    }
+
+    void PlaneArray::Clear() {
+        NormalX.clear();
+        NormalY.clear();
+        NormalZ.clear();
+        D.clear();
+        Materials.clear();
+    }
+
+    Plane PlaneArray::Get(UIndex i) const {
+        return Plane(Materials[i], GetNormal(i), D[i]);
+    }
+
+    Intersection PlaneArray::GetIntersection(UIndex i, const Ray& ray,
+            const Hit& hit) const {
+        const Vec3 normal = GetNormal(i);
+        return Intersection(
+            ray.Traverse(hit.Distance),
+            glm::dot(ray.Direction, normal) > 0.0f ? -normal : normal,
+            Materials[i]
+        );
+    }
+
+    // TriangleArray
+
+    std::optional<UIndex> TriangleArray::IntersectRange(UIndex first,
+            UCount count, const Ray& ray, Hit& hit) const {
+        std::optional<UIndex> result = std::nullopt;
+#if defined(BEAM_SIMD)
+        // Möller-Trumbore on simd::Width triangles at a time, see
+        // Triangle::Intersect for the scalar version.
+        using simd::Float;
+        constexpr UCount  width   = simd::Width;
+        constexpr Float32 epsilon = 1.0e-7f;
+        const simd::Vec3
+            D = simd::Vec3::Broadcast(ray.Direction),
+            O = simd::Vec3::Broadcast(ray.Origin);
+        const Float
+            zero     = Float::Broadcast(0.0f),
+            one      = Float::Broadcast(1.0f),
+            eps      = Float::Broadcast(epsilon),
+            neg_eps  = Float::Broadcast(-epsilon),
+            max_t    = Float::Broadcast(1.0f / epsilon);
+        const std::array<const std::vector<Float32>*, 9> arrays {
+            &AX, &AY, &AZ, &ABX, &ABY, &ABZ, &ACX, &ACY, &ACZ
+        };
+        const UIndex end = first + count;
+        for (UIndex i = first; i < end; i += width) {
+            // Loads may not go past the end of the arrays, so the last block
+            // is copied out and padded with degenerate triangles.
+            std::array<Float, 9> values;
+            if (i + width <= GetCount()) {
+                for (UIndex k = 0u; k < 9u; k++)
+                    values[k] = Float::Load(arrays[k]->data() + i);
+            } else {
+                for (UIndex k = 0u; k < 9u; k++) {
+                    std::array<Float32, width> padded { };
+                    std::copy(arrays[k]->begin() + i, arrays[k]->end(),
+                        padded.begin());
+                    values[k] = Float::Load(padded.data());
+                }
+            }
+            const simd::Vec3
+                A  { values[0], values[1], values[2] },
+                AB { values[3], values[4], values[5] },
+                AC { values[6], values[7], values[8] },
+                h  = simd::cross(D, AC);
+            const Float
+                a     = simd::dot(AB, h),
+                inv_a = one / a;
+            const simd::Vec3 AO = O - A;
+            const Float      u  = inv_a * simd::dot(AO, h);
+            const simd::Vec3 q  = simd::cross(AO, AB);
+            const Float
+                v = inv_a * simd::dot(D, q),
+                t = inv_a * simd::dot(AC, q);
+            const simd::Mask valid
+                = ((a > eps) | (a < neg_eps))
+                & (u >= zero) & (u <= one)
+                & (v >= zero) & (u + v <= one)
+                & (t > eps)
+                & (t < max_t) & (t < Float::Broadcast(hit.Distance));
+            UInt32 bits = valid.GetBits();
+            if (i + width > end)
+                bits &= (1u << (end - i)) - 1u;
+            if (bits == 0u)
+                continue;
+            std::array<Float32, width> ts, us, vs;
+            t.Store(ts.data());
+            u.Store(us.data());
+            v.Store(vs.data());
+            for (UIndex lane = 0u; lane < width; lane++) {
+                if ((bits & (1u << lane)) && ts[lane] < hit.Distance) {
+                    hit.Distance     = ts[lane];
+                    hit.Primitive    = 0u;
+                    hit.Barycentrics = { us[lane], vs[lane] };
+                    result           = i + lane;
+                }
+            }
+        }
+#else
+        for (UIndex i = first; i < first + count; i++)
+            if (Intersect(i, ray, hit))
+                result = i;
+#endif
+        return result;
+    }
+
+    void TriangleArray::Add(const Triangle& triangle) {
+        const Vec3
+            A  = triangle.GetA(),
+            AB = triangle.GetB() - A,
+            AC = triangle.GetC() - A;
+        AX.push_back(A.x);
+        AY.push_back(A.y);
+        AZ.push_back(A.z);
+        ABX.push_back(AB.x);
+        ABY.push_back(AB.y);
+        ABZ.push_back(AB.z);
+        ACX.push_back(AC.x);
+        ACY.push_back(AC.y);
+        ACZ.push_back(AC.z);
+        Normals.push_back(triangle.GetNormal());
+        Materials.push_back(triangle.Material);
+    }
+
+    void TriangleArray::Set(UIndex i, const Triangle& triangle) {
+        const Vec3
+            A  = triangle.GetA(),
+            AB = triangle.GetB() - A,
+            AC = triangle.GetC() - A;
+        AX[i]        = A.x;
+        AY[i]        = A.y;
+        AZ[i]        = A.z;
+        ABX[i]       = AB.x;
+        ABY[i]       = AB.y;
+        ABZ[i]       = AB.z;
+        ACX[i]       = AC.x;
+        ACY[i]       = AC.y;
+        ACZ[i]       = AC.z;
+        Normals[i]   = triangle.GetNormal();
+        Materials[i] = triangle.Material;
+    }
+
+    void TriangleArray::Clear() {
+        for (auto* values : { &AX, &AY, &AZ, &ABX, &ABY, &ABZ, &ACX, &ACY,
+                &ACZ })
+            values->clear();
+        Normals.clear();
+        Materials.clear();
+    }
+
+    void TriangleArray::Reorder(const std::vector<UInt32>& order) {
+        for (auto* values : { &AX, &AY, &AZ, &ABX, &ABY, &ABZ, &ACX, &ACY,
+                &ACZ })
+            reorder(*values, order);
+        reorder(Normals,   order);
+        reorder(Materials, order);
+    }
+
+    Triangle TriangleArray::Get(UIndex i) const {
+        const Vec3 A = GetA(i);
+        return Triangle(Materials[i], A, A + GetAB(i), A + GetAC(i));
+    }
+
+    AABB TriangleArray::GetBoundingBox(UIndex i) const {
+        return Get(i).GetBoundingBox();
+    }
+
+    Intersection TriangleArray::GetIntersection(UIndex i, const Ray& ray,
+            const Hit& hit) const {
+        return Intersection(ray.Traverse(hit.Distance), Normals[i],
+            Materials[i]);
+    }
+
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include "raytracing/Objects.hpp"
+
+namespace beam {
+
+    // Contiguous structure of arrays storage for the built-in primitive
+    // types, so that intersection loops run over dense data without virtual
+    // calls. The data needed to find hits is kept apart from the data only
+    // needed to shade them, like normals and materials.
+
+    // Puts the elements of values in the given order, which needs to contain
+    // every index exactly once.
+    template <typename ValueT>
+    void reorder(std::vector<ValueT>& values,
+            const std::vector<UInt32>& order) {
+        std::vector<ValueT> reordered;
+        reordered.reserve(order.size());
+        for (const UInt32 index : order)
+            reordered.push_back(std::move(values[index]));
+        values = std::move(reordered);
+    }
+
+    struct SphereArray {
+        std::vector<Float32>  CenterX, CenterY, CenterZ, Radius;
+        std::vector<Material> Materials;
+
+        inline UCount GetCount() const { return Radius.size(); }
+
+        inline Vec3 GetCenter(UIndex i) const {
+            return { CenterX[i], CenterY[i], CenterZ[i] };
+        }
+
+        inline bool Intersect(UIndex i, const Ray& ray, Hit& hit) const {
+            const Vec3
+                O_C = ray.Origin - GetCenter(i);
+            const Float32
+                a   = glm::dot(ray.Direction, ray.Direction),
+                b   = 2.0f * glm::dot(ray.Direction, O_C),
+                c   = glm::dot(O_C, O_C) - Radius[i] * Radius[i],
+                D   = b * b - 4.0f * a * c;
+            if (D < 0.0f)
+                return false;
+            const Float32
+                s   = glm::sqrt(D),
+                t_0 = (-b + s) / (2.0f * a),
+                t_1 = (-b - s) / (2.0f * a),
+                // The nearer root, unless the ray starts inside the sphere
+                t   = t_1 >= 0.0f ? t_1 : t_0;
+            if (t < 0.0f || t >= hit.Distance)
+                return false;
+            hit.Distance  = t;
+            hit.Primitive = 0u;
+            return true;
+        }
+
+        void Add(const Sphere& sphere);
+        void Set(UIndex i, const Sphere& sphere);
+        void Clear();
+        void Reorder(const std::vector<UInt32>& order);
+        Sphere Get(UIndex i) const;
+        AABB GetBoundingBox(UIndex i) const;
+        Intersection GetIntersection(UIndex i, const Ray& ray,
+            const Hit& hit) const;
+    };
+
+    struct PlaneArray {
+        std::vector<Float32>  NormalX, NormalY, NormalZ, D;
+        std::vector<Material> Materials;
+
+        inline UCount GetCount() const { return D.size(); }
+
+        inline Vec3 GetNormal(UIndex i) const {
+            return { NormalX[i], NormalY[i], NormalZ[i] };
+        }
+
+        inline bool Intersect(UIndex i, const Ray& ray, Hit& hit) const {
+            const Vec3 normal = GetNormal(i);
+            const Float32 t
+                = -(glm::dot(ray.Origin,    normal) + D[i])
+                /   glm::dot(ray.Direction, normal);
+            if (!(t >= 0.0f && t < hit.Distance))
+                return false;
+            hit.Distance  = t;
+            hit.Primitive = 0u;
+            return true;
+        }
+
+        void Add(const Plane& plane);
+        void Clear();
+        Plane Get(UIndex i) const;
+        Intersection GetIntersection(UIndex i, const Ray& ray,
+            const Hit& hit) const;
+    };
+
+    struct TriangleArray {
+        // The first vertex and the two edges leaving it
+        std::vector<Float32>  AX, AY, AZ;
+        std::vector<Float32>  ABX, ABY, ABZ;
+        std::vector<Float32>  ACX, ACY, ACZ;
+        std::vector<Vec3>     Normals;
+        std::vector<Material> Materials;
+
+        inline UCount GetCount() const { return AX.size(); }
+
+        inline Vec3 GetA(UIndex i) const { return { AX[i], AY[i], AZ[i] }; }
+        inline Vec3 GetAB(UIndex i) const {
+            return { ABX[i], ABY[i], ABZ[i] };
+        }
+        inline Vec3 GetAC(UIndex i) const {
+            return { ACX[i], ACY[i], ACZ[i] };
+        }
+
+        inline bool Intersect(UIndex i, const Ray& ray, Hit& hit) const {
+            // Möller-Trumbore, see Triangle::Intersect
+            constexpr Float32 epsilon = 1.0e-7f;
+            const Vec3
+                AB = GetAB(i),
+                AC = GetAC(i),
+                h  = glm::cross(ray.Direction, AC);
+            const Float32 a = glm::dot(AB, h);
+            if (-epsilon < a && a < epsilon)
+                return false;
+            const Float32 inv_a = 1.0f / a;
+            const Vec3    AO    = ray.Origin - GetA(i);
+            const Float32 u     = inv_a * glm::dot(AO, h);
+            if (u < 0.0f || 1.0f < u)
+                return false;
+            const Vec3    q = glm::cross(AO, AB);
+            const Float32 v = inv_a * glm::dot(ray.Direction, q);
+            if (v < 0.0f || 1.0f < u + v)
+                return false;
+            const Float32 t = inv_a * glm::dot(AC, q);
+            if (!(epsilon < t && t < std::min(hit.Distance, 1.0f / epsilon)))
+                return false;
+            hit.Distance     = t;
+            hit.Primitive    = 0u;
+            hit.Barycentrics = { u, v };
+            return true;
+        }
+
+        // Tests the ray against the triangles in [first, first + count) and
+        // records the closest hit, if it's closer than hit.Distance. Uses
+        // SIMD to test several triangles at once when it's available.
+        // Returns the index of the triangle that was hit.
+        std::optional<UIndex> IntersectRange(UIndex first, UCount count,
+            const Ray& ray, Hit& hit) const;
+
+        void Add(const Triangle& triangle);
+        void Set(UIndex i, const Triangle& triangle);
+        void Clear();
+        void Reorder(const std::vector<UInt32>& order);
+        Triangle Get(UIndex i) const;
+        AABB GetBoundingBox(UIndex i) const;
+        Intersection GetIntersection(UIndex i, const Ray& ray,
+            const Hit& hit) const;
+    };
+
+}
@@ -10,6 +10,8 @@ namespace beam {
     struct Ray {
         Vec3 Origin, Direction;
         
+        constexpr Ray()
+            : Origin(0.0f, 0.0f, 0.0f), Direction(0.0f, 0.0f, 1.0f) { }
         constexpr Ray(const Vec3& origin, const Vec3& direction)
             : Origin(origin), Direction(direction) { }
         
@@ -18,6 +20,20 @@ namespace beam {
         }
     };
 
+    // Returns two unit vectors that form an orthonormal basis with the given
+    // unit vector, see "Building an Orthonormal Basis, Revisited" (Duff et
+    // al. 2017).
+    inline std::pair<Vec3, Vec3> get_tangents(const Vec3& n) {
+        const Float32
+            sign = std::copysign(1.0f, n.z),
+            a    = -1.0f / (sign + n.z),
+            b    = n.x * n.y * a;
+        return {
+            Vec3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x),
+            Vec3(b, sign + n.y * n.y * a, -n.y)
+        };
+    }
+
     enum class MaterialType : UInt8 {
         Diffuse
     };
@@ -34,6 +50,11 @@ namespace beam {
         { }
         constexpr Material(MaterialType type, beam::Color color, Float32 emission)
             : Type(type), Color(color), Emission(emission) { }
+
+        // The radiance that surfaces with this material emit
+        inline Vec3 GetEmittedRadiance() const {
+            return Vec3(Color) * Emission;
+        }
     };
 
     struct Intersection {
@@ -53,15 +74,60 @@ namespace beam {
         ) : Point(point), Normal(normal), Material(material) { }
     };
 
+    // A compact record of the closest hit found so far along a ray. The
+    // intersection routines only fill this in; the full Intersection is built
+    // once, for the final closest hit.
+    struct Hit {
+        // The distance along the ray, in units of the ray direction. Only hits
+        // closer than this are accepted, so it doubles as the ray's t_max.
+        Float32 Distance;
+        // The index of the object that was hit within its container.
+        UInt32  Object;
+        // The index of the primitive that was hit within the object, for
+        // objects that consist of multiple primitives.
+        UInt32  Primitive;
+        // Barycentric coordinates of the hit on triangles.
+        Vec2    Barycentrics;
+
+        constexpr Hit()
+            : Hit(std::numeric_limits<Float32>::infinity())
+        { }
+        constexpr Hit(Float32 max_distance)
+            : Distance(max_distance)
+            , Object(0u)
+            , Primitive(0u)
+            , Barycentrics({ 0.0f, 0.0f })
+        { }
+    };
+
     class Intersectable {
     public:
         Intersectable() { }
         virtual ~Intersectable() { }
         
         virtual AABB GetBoundingBox() const = 0;
-        virtual std::optional<Intersection> Intersect(const Ray& ray) const = 0;
-        virtual bool Intersects(const Ray& ray) const {
-            return Intersect(ray).has_value();
+        // Looks for an intersection closer than hit.Distance and, if there
+        // is one, records it in hit. Returns whether one was found.
+        virtual bool Intersect(const Ray& ray, Hit& hit) const = 0;
+        // Builds the full intersection for a hit found by Intersect.
+        virtual Intersection GetIntersection(const Ray& ray, const Hit& hit)
+            const = 0;
+        // Returns whether the ray hits anything closer than t_max, in units
+        // of its direction. Unlike Intersect, this can stop at the first hit
+        // it finds, which is all that shadow rays need to know.
+        virtual bool Intersects(const Ray& ray, Float32 t_max) const {
+            Hit hit(t_max);
+            return Intersect(ray, hit);
+        }
+        bool Intersects(const Ray& ray) const {
+            return Intersects(ray, std::numeric_limits<Float32>::infinity());
+        }
+
+        std::optional<Intersection> Intersect(const Ray& ray) const {
+            Hit hit;
+            if (!Intersect(ray, hit))
+                return std::nullopt;
+            return GetIntersection(ray, hit);
         }
     };
 
@@ -0,0 +1,578 @@
+#include "Common.hpp"
+#include "Scene.hpp"
+
+namespace beam {
+
+    UIndex Scene::AddInstance(UIndex mesh, const Mat4& transform) {
+        m_instances.emplace_back(UInt32(mesh), transform,
+            m_meshes[mesh].GetBoundingBox());
+        return m_instances.size() - 1u;
+    }
+
+    void Scene::SetInstanceTransform(UIndex instance, const Mat4& transform) {
+        Instance& target = m_instances[instance];
+        target.SetTransform(transform,
+            m_meshes[target.MeshID].GetBoundingBox());
+    }
+
+    void Scene::UpdateInstances(ThreadPool* pool) {
+        BuildInstances(pool);
+        BuildLights();
+        m_revision++;
+    }
+
+    AABB Scene::GetBoundingBox() const {
+        AABB aabb = AABB::Nothing();
+        for (UIndex i = 0u; i < m_spheres.GetCount(); i++)
+            aabb.Combine(m_spheres.GetBoundingBox(i));
+        if (m_planes.GetCount() > 0u)
+            aabb = AABB::Infinite();
+        for (UIndex i = 0u; i < m_triangles.GetCount(); i++)
+            aabb.Combine(m_triangles.GetBoundingBox(i));
+        for (const Instance& instance : m_instances)
+            aabb.Combine(instance.GetBoundingBox());
+        for (const auto& object : m_objects)
+            aabb.Combine(object->GetBoundingBox());
+        return aabb;
+    }
+
+    bool Scene::Intersect(const Ray& ray, Hit& hit) const {
+        bool found = IntersectUnbounded(ray, hit);
+        const auto traverse = [&](ObjectKind kind, const BVH& bvh) {
+            bvh.Traverse(ray, hit.Distance, [&](UInt32 first, UInt32 count) {
+                found |= IntersectLeaf(kind, first, count, ray, hit);
+            });
+        };
+        traverse(ObjectKind::Sphere,   m_sphere_bvh);
+        traverse(ObjectKind::Triangle, m_triangle_bvh);
+        traverse(ObjectKind::Instance, m_instance_bvh);
+        traverse(ObjectKind::Object,   m_object_bvh);
+        return found;
+    }
+
+    bool Scene::Intersects(const Ray& ray, Float32 t_max) const {
+        if (IntersectsLeaf(ObjectKind::Plane, 0u, m_planes.GetCount(), ray,
+                t_max))
+            return true;
+        for (const UIndex object : m_unbounded)
+            if (m_objects[object]->Intersects(ray, t_max))
+                return true;
+        const auto traverse = [&](ObjectKind kind, const BVH& bvh) {
+            return bvh.TraverseAny(ray, t_max,
+                [&](UInt32 first, UInt32 count) {
+                    return IntersectsLeaf(kind, first, count, ray, t_max);
+                });
+        };
+        return traverse(ObjectKind::Sphere,   m_sphere_bvh)
+            || traverse(ObjectKind::Triangle, m_triangle_bvh)
+            || traverse(ObjectKind::Instance, m_instance_bvh)
+            || traverse(ObjectKind::Object,   m_object_bvh);
+    }
+
+    UInt32 Scene::IntersectPacket(const Ray* rays, UCount count, Hit* hits)
+            const {
+        BEAM_DEBUG_ONLY {
+            if (count > PacketSize)
+                throw std::runtime_error("Ray packet is too large.");
+        }
+        UInt32 found = 0u;
+        const auto bounds = BVH::GetPacketBounds(rays, count);
+        if (!bounds) {
+            for (UIndex i = 0u; i < count; i++)
+                if (Intersect(rays[i], hits[i]))
+                    found |= 1u << i;
+            return found;
+        }
+
+        for (UIndex i = 0u; i < count; i++)
+            if (IntersectUnbounded(rays[i], hits[i]))
+                found |= 1u << i;
+        const auto traverse = [&](ObjectKind kind, const BVH& bvh) {
+            bvh.TraversePacket(*bounds, hits, count,
+                [&](UInt32 first, UInt32 leaf_count) {
+                    for (UIndex i = 0u; i < count; i++)
+                        if (IntersectLeaf(kind, first, leaf_count, rays[i],
+                                hits[i]))
+                            found |= 1u << i;
+                });
+        };
+        traverse(ObjectKind::Sphere,   m_sphere_bvh);
+        traverse(ObjectKind::Triangle, m_triangle_bvh);
+        traverse(ObjectKind::Instance, m_instance_bvh);
+        traverse(ObjectKind::Object,   m_object_bvh);
+        return found;
+    }
+
+    bool Scene::IntersectUnbounded(const Ray& ray, Hit& hit) const {
+        bool found = IntersectLeaf(ObjectKind::Plane, 0u, m_planes.GetCount(),
+            ray, hit);
+        for (const UIndex object : m_unbounded) {
+            if (m_objects[object]->Intersect(ray, hit)) {
+                hit.Object = MakeObjectID(ObjectKind::Object, object);
+                found      = true;
+            }
+        }
+        return found;
+    }
+
+    bool Scene::IntersectLeaf(ObjectKind kind, UIndex first, UCount count,
+            const Ray& ray, Hit& hit) const {
+        bool found = false;
+        const auto intersect = [&](const auto& primitives) {
+            for (UIndex i = first; i < first + count; i++) {
+                if (primitives.Intersect(i, ray, hit)) {
+                    hit.Object = MakeObjectID(kind, i);
+                    found      = true;
+                }
+            }
+        };
+        switch (kind) {
+        case ObjectKind::Sphere:
+            intersect(m_spheres);
+            break;
+        case ObjectKind::Plane:
+            intersect(m_planes);
+            break;
+        case ObjectKind::Triangle:
+            if (const auto triangle =
+                    m_triangles.IntersectRange(first, count, ray, hit)) {
+                hit.Object = MakeObjectID(ObjectKind::Triangle, *triangle);
+                found      = true;
+            }
+            break;
+        case ObjectKind::Instance:
+            for (UIndex i = first; i < first + count; i++) {
+                // Meshes are intersected in their own space, where the
+                // distances along the ray are the same
+                const UIndex    index    = m_instance_order[i];
+                const Instance& instance = m_instances[index];
+                if (m_meshes[instance.MeshID].Intersect(
+                        instance.ToObjectSpace(ray), hit)) {
+                    hit.Object = MakeObjectID(ObjectKind::Instance, index);
+                    found      = true;
+                }
+            }
+            break;
+        default:
+            for (UIndex i = first; i < first + count; i++) {
+                const UIndex object = m_bounded[i];
+                if (m_objects[object]->Intersect(ray, hit)) {
+                    hit.Object = MakeObjectID(ObjectKind::Object, object);
+                    found      = true;
+                }
+            }
+            break;
+        }
+        return found;
+    }
+
+    bool Scene::IntersectsLeaf(ObjectKind kind, UIndex first, UCount count,
+            const Ray& ray, Float32 t_max) const {
+        Hit hit(t_max);
+        const auto intersects = [&](const auto& primitives) {
+            for (UIndex i = first; i < first + count; i++)
+                if (primitives.Intersect(i, ray, hit))
+                    return true;
+            return false;
+        };
+        switch (kind) {
+        case ObjectKind::Sphere:
+            return intersects(m_spheres);
+        case ObjectKind::Plane:
+            return intersects(m_planes);
+        case ObjectKind::Triangle:
+            return m_triangles.IntersectRange(first, count, ray, hit)
+                .has_value();
+        case ObjectKind::Instance:
+            for (UIndex i = first; i < first + count; i++) {
+                const Instance& instance = m_instances[m_instance_order[i]];
+                if (m_meshes[instance.MeshID].Intersects(
+                        instance.ToObjectSpace(ray), t_max))
+                    return true;
+            }
+            return false;
+        default:
+            for (UIndex i = first; i < first + count; i++)
+                if (m_objects[m_bounded[i]]->Intersects(ray, t_max))
+                    return true;
+            return false;
+        }
+    }
+
+    Intersection Scene::GetIntersection(const Ray& ray, const Hit& hit) const {
+        const UIndex index = hit.Object & ObjectIndexMask;
+        switch (ObjectKind(hit.Object >> ObjectKindShift)) {
+        case ObjectKind::Sphere:
+            return m_spheres.GetIntersection(index, ray, hit);
+        case ObjectKind::Plane:
+            return m_planes.GetIntersection(index, ray, hit);
+        case ObjectKind::Triangle:
+            return m_triangles.GetIntersection(index, ray, hit);
+        case ObjectKind::Instance: {
+            const Instance& instance = m_instances[index];
+            return instance.ToWorldSpace(ray, hit.Distance,
+                m_meshes[instance.MeshID].GetIntersection(
+                    instance.ToObjectSpace(ray), hit));
+        }
+        default:
+            return m_objects[index]->GetIntersection(ray, hit);
+        }
+    }
+
+    // Returns the bounds of the primitives of an array, in array order.
+    template <typename ArrayT>
+    static std::vector<AABB> get_bounds(const ArrayT& primitives) {
+        std::vector<AABB> bounds;
+        bounds.reserve(primitives.GetCount());
+        for (UIndex i = 0u; i < primitives.GetCount(); i++)
+            bounds.push_back(primitives.GetBoundingBox(i));
+        return bounds;
+    }
+
+    // Returns the bounds of the instances in the given order.
+    static std::vector<AABB> get_bounds(const std::vector<Instance>& instances,
+            const std::vector<UIndex>& order) {
+        std::vector<AABB> bounds;
+        bounds.reserve(order.size());
+        for (const UIndex instance : order)
+            bounds.push_back(instances[instance].GetBoundingBox());
+        return bounds;
+    }
+
+    void Scene::Build(ThreadPool* pool) {
+        BuildSpheres(pool);
+        BuildTriangles(pool);
+        BuildInstances(pool);
+        BuildObjects(pool);
+        BuildLights();
+        m_revision++;
+    }
+
+    void Scene::Refit(ThreadPool* pool, Float32 rebuild_threshold) {
+        const auto is_degraded = [&](const BVH& bvh) {
+            const BVH::Stats& stats = bvh.GetStats();
+            return stats.Cost > rebuild_threshold * stats.BuildCost;
+        };
+
+        m_sphere_bvh.Refit(get_bounds(m_spheres));
+        if (is_degraded(m_sphere_bvh))
+            BuildSpheres(pool);
+
+        m_triangle_bvh.Refit(get_bounds(m_triangles));
+        if (is_degraded(m_triangle_bvh))
+            BuildTriangles(pool);
+
+        for (Mesh& mesh : m_meshes)
+            mesh.Refit(pool, rebuild_threshold);
+        for (Instance& instance : m_instances)
+            instance.SetMeshBounds(m_meshes[instance.MeshID].GetBoundingBox());
+        m_instance_bvh.Refit(get_bounds(m_instances, m_instance_order));
+        if (is_degraded(m_instance_bvh))
+            BuildInstances(pool);
+
+        // Objects that became bounded or unbounded need to move between
+        // the hierarchy and the list of objects tested for every ray
+        std::vector<AABB> bounds;
+        bool moved = false;
+        for (const UIndex object : m_bounded) {
+            bounds.push_back(m_objects[object]->GetBoundingBox());
+            moved |= !bounds.back().IsFinite();
+        }
+        for (const UIndex object : m_unbounded)
+            moved |= m_objects[object]->GetBoundingBox().IsFinite();
+        if (!moved)
+            m_object_bvh.Refit(bounds);
+        if (moved || is_degraded(m_object_bvh))
+            BuildObjects(pool);
+        BuildLights();
+
+        m_revision++;
+    }
+
+    void Scene::BuildSpheres(ThreadPool* pool) {
+        // Put the primitives in BVH order, so that every leaf refers to a
+        // contiguous range of them.
+        m_sphere_bvh.Build(get_bounds(m_spheres), pool);
+        m_spheres.Reorder(m_sphere_bvh.GetIndices());
+    }
+
+    void Scene::BuildTriangles(ThreadPool* pool) {
+        m_triangle_bvh.Build(get_bounds(m_triangles), pool);
+        m_triangles.Reorder(m_triangle_bvh.GetIndices());
+    }
+
+    void Scene::BuildInstances(ThreadPool* pool) {
+        // Instances keep their indices, so the order is kept separately
+        m_instance_order.resize(m_instances.size());
+        std::iota(m_instance_order.begin(), m_instance_order.end(), UIndex(0u));
+        m_instance_bvh.Build(get_bounds(m_instances, m_instance_order), pool);
+        reorder(m_instance_order, m_instance_bvh.GetIndices());
+    }
+
+    void Scene::BuildObjects(ThreadPool* pool) {
+        std::vector<AABB> bounds;
+        m_bounded.clear();
+        m_unbounded.clear();
+        for (UIndex i = 0u; i < m_objects.size(); i++) {
+            const AABB aabb = m_objects[i]->GetBoundingBox();
+            if (aabb.IsFinite()) {
+                m_bounded.push_back(i);
+                bounds.push_back(aabb);
+            } else {
+                m_unbounded.push_back(i);
+            }
+        }
+        m_object_bvh.Build(bounds, pool);
+        reorder(m_bounded, m_object_bvh.GetIndices());
+    }
+
+    void Scene::BuildLights() {
+        m_lights->Clear();
+        m_light_indices.clear();
+        const auto add = [&](ObjectKind kind, UIndex index, UInt32 primitive,
+                const Light& light) {
+            if (m_lights->Add(light))
+                m_light_indices[MakeLightKey(MakeObjectID(kind, index),
+                    primitive)] = UInt32(m_lights->GetLights().size() - 1u);
+        };
+        for (UIndex i = 0u; i < m_spheres.GetCount(); i++) {
+            const Material& material = m_spheres.Materials[i];
+            if (material.Emission > 0.0f)
+                add(ObjectKind::Sphere, i, 0u, Light::MakeSphere(
+                    m_spheres.GetCenter(i), m_spheres.Radius[i],
+                    material.GetEmittedRadiance()));
+        }
+        for (UIndex i = 0u; i < m_triangles.GetCount(); i++) {
+            const Material& material = m_triangles.Materials[i];
+            if (material.Emission > 0.0f) {
+                const Vec3 a = m_triangles.GetA(i);
+                add(ObjectKind::Triangle, i, 0u, Light::MakeTriangle(a,
+                    a + m_triangles.GetAB(i), a + m_triangles.GetAC(i),
+                    material.GetEmittedRadiance()));
+            }
+        }
+        // Every instance of an emissive mesh adds its triangles in world
+        // space
+        for (UIndex i = 0u; i < m_instances.size(); i++) {
+            const Instance& instance = m_instances[i];
+            const Mesh&     mesh     = m_meshes[instance.MeshID];
+            if (!(mesh.Material.Emission > 0.0f))
+                continue;
+            const auto& vertices = mesh.GetVertices();
+            const auto& indices  = mesh.GetIndices();
+            const auto  to_world = [&](UInt32 vertex) {
+                return Vec3(instance.GetTransform()
+                    * Vec4(vertices[vertex], 1.0f));
+            };
+            for (UIndex t = 0u; t < mesh.GetTriangleCount(); t++)
+                add(ObjectKind::Instance, i, UInt32(t), Light::MakeTriangle(
+                    to_world(indices[3u * t]),
+                    to_world(indices[3u * t + 1u]),
+                    to_world(indices[3u * t + 2u]),
+                    mesh.Material.GetEmittedRadiance()));
+        }
+        m_lights->Build();
+    }
+
+    void Scene::SetLightSampler(std::unique_ptr<LightSampler> lights) {
+        m_lights = std::move(lights);
+        BuildLights();
+        m_revision++;
+    }
+
+    Float32 Scene::GetLightPdf(const Vec3& point, const Vec3& normal,
+            const Hit& hit, const Intersection& intersection) const {
+        const auto light =
+            m_light_indices.find(MakeLightKey(hit.Object, hit.Primitive));
+        if (light == m_light_indices.end())
+            return 0.0f;
+        return m_lights->GetPdf(light->second, point, normal,
+            intersection.Point, intersection.Normal);
+    }
+
+    void Scene::PrintBuildStats(std::ostream& out) const {
+        const auto print = [&](const std::string& name, const BVH& bvh) {
+            if (bvh.IsEmpty())
+                return;
+            const BVH::Stats& stats = bvh.GetStats();
+            out << name << " BVH: " << stats.PrimitiveCount
+                << " primitives, " << stats.NodeCount << " nodes ("
+                << stats.WideNodeCount << " " << BVH::Width << "-wide), SAH"
+                " cost " << stats.Cost << ", built in " << stats.BuildTime
+                << " ms" << std::endl;
+        };
+        print("Sphere",   m_sphere_bvh);
+        print("Triangle", m_triangle_bvh);
+        for (UIndex i = 0u; i < m_meshes.size(); i++)
+            print("Mesh " + std::to_string(i), m_meshes[i].GetBVH());
+        print("Instance", m_instance_bvh);
+        print("Object",   m_object_bvh);
+        if (!m_lights->IsEmpty())
+            m_lights->PrintStats(out);
+    }
+
+    void Scene::Clear() {
+        m_spheres.Clear();
+        m_planes.Clear();
+        m_triangles.Clear();
+        m_sphere_bvh.Clear();
+        m_triangle_bvh.Clear();
+        m_meshes.clear();
+        m_instances.clear();
+        m_instance_bvh.Clear();
+        m_instance_order.clear();
+        m_objects.clear();
+        m_object_bvh.Clear();
+        m_bounded.clear();
+        m_unbounded.clear();
+        m_lights->Clear();
+        m_light_indices.clear();
+        m_revision++;
+    }
+
+    UInt32 TraceSettings::GetSampleCount(
+            const AccumulationBuffer& accumulation, UIndex u, UIndex v) const {
+        const UInt32 count = accumulation.GetSampleCount(u, v);
+        if (MaxSamples > 0u && count >= MaxSamples)
+            return 0u;
+        if (count >= MinSamples && ErrorThreshold > 0.0f
+                && accumulation.GetRelativeError(u, v) <= ErrorThreshold)
+            return 0u;
+        if (MaxSamples > 0u)
+            return std::min(SamplesPerPixel, MaxSamples - count);
+        return SamplesPerPixel;
+    }
+
+    UCount Scene::Trace(const Camera& camera, const Color& sky_color,
+            const Integrator& integrator, const Sampler& sampler,
+            const TraceSettings& settings, ThreadPool& pool,
+            AccumulationBuffer& accumulation, PixelBuffer& buffer) const {
+        constexpr UCount
+            tile_size = 16u;
+        const USize
+            width  = buffer.GetWidth(),
+            height = buffer.GetHeight();
+        BEAM_DEBUG_ONLY {
+            if (accumulation.GetWidth() != width
+                    || accumulation.GetHeight() != height)
+                throw std::runtime_error("Buffer sizes don't match.");
+        }
+        accumulation.Synchronize(camera.GetRevision(), m_revision);
+        const UCount
+            tiles_x = (width  + tile_size - 1u) / tile_size,
+            tiles_y = (height + tile_size - 1u) / tile_size;
+        const Float32
+            du = 1.0f / Float32(width),
+            dv = 1.0f / Float32(height);
+        // Space that every thread reuses for its tiles. Every sample of a
+        // packet is in flight at the same time, so each one has its own
+        // copy of the sampler.
+        struct TileScratch {
+            std::array<std::unique_ptr<Sampler>, PacketSize> Samplers;
+            std::array<UInt32, tile_size * tile_size> Counts, Firsts;
+            CameraSamples Samples;
+            CameraRays    Rays;
+        };
+        std::vector<TileScratch> scratch(pool.GetThreadCount());
+        std::atomic<UCount> total_samples = 0u;
+        pool.ParallelFor(tiles_x * tiles_y, [&](UIndex tile, UIndex thread) {
+            const UIndex
+                u_begin = (tile % tiles_x) * tile_size,
+                v_begin = (tile / tiles_x) * tile_size,
+                u_end   = std::min(u_begin + tile_size, width),
+                v_end   = std::min(v_begin + tile_size, height);
+            TileScratch& tile_scratch = scratch[thread];
+            auto& samplers = tile_scratch.Samplers;
+            if (!samplers[0])
+                for (auto& packet_sampler : samplers)
+                    packet_sampler = sampler.Clone();
+            const auto get_local = [&](UIndex u, UIndex v) {
+                return (v - v_begin) * tile_size + (u - u_begin);
+            };
+
+            // The camera rays of every sample of the tile are generated at
+            // once, ordered by pixel
+            CameraSamples& camera_samples = tile_scratch.Samples;
+            camera_samples.Clear();
+            for (UIndex v = v_begin; v < v_end; v++) {
+                for (UIndex u = u_begin; u < u_end; u++) {
+                    const UIndex local = get_local(u, v);
+                    const UInt32 sample_count =
+                        settings.GetSampleCount(accumulation, u, v);
+                    const UInt32 first_sample =
+                        accumulation.GetSampleCount(u, v);
+                    tile_scratch.Counts[local] = sample_count;
+                    tile_scratch.Firsts[local] = first_sample;
+                    const Float32
+                        ru = u * du,
+                        rv = v * dv;
+                    Sampler& sample = *samplers[0];
+                    for (UInt32 i = 0u; i < sample_count; i++) {
+                        sample.StartSample(UInt32(u + v * width),
+                            first_sample + i);
+                        const Vec2 offset = sample.GetPixel();
+                        camera_samples.Add(
+                            ru + (2.0f * offset.x - 1.0f) * du,
+                            rv + (2.0f * offset.y - 1.0f) * dv,
+                            sample.GetLens()
+                        );
+                    }
+                }
+            }
+            const CameraRays& camera_rays = tile_scratch.Rays;
+            camera.GenerateRays(camera_samples, tile_scratch.Rays);
+
+            UCount tile_samples = 0u;
+            for (UIndex v = v_begin; v < v_end; v++) {
+                for (UIndex u = u_begin; u < u_end; u++) {
+                    const UIndex local = get_local(u, v);
+                    const UInt32
+                        sample_count = tile_scratch.Counts[local],
+                        first_sample = tile_scratch.Firsts[local];
+                    if (sample_count == 0u) {
+                        buffer.At(u, v) = accumulation.GetMean(u, v);
+                        continue;
+                    }
+                    Color   sum(0.0f);
+                    Float32 luminance_sq_sum = 0.0f;
+                    // The samples of a pixel are traced in packets, since
+                    // their rays are nearly the same
+                    std::array<Ray, PacketSize> rays;
+                    std::array<Hit, PacketSize> hits;
+                    for (UInt32 packet = 0u; packet < sample_count;
+                            packet += PacketSize) {
+                        const UCount count = std::min(UCount(PacketSize),
+                            UCount(sample_count - packet));
+                        // The rays of the pixel follow those of the
+                        // samples taken so far in the tile
+                        for (UIndex i = 0u; i < count; i++) {
+                            samplers[i]->StartSample(UInt32(u + v * width),
+                                UInt32(first_sample + packet + i));
+                            rays[i] = camera_rays.Get(
+                                tile_samples + packet + i);
+                            hits[i] = Hit();
+                        }
+                        const UInt32 found =
+                            IntersectPacket(rays.data(), count, hits.data());
+                        for (UIndex i = 0u; i < count; i++) {
+                            const Color color = integrator.Integrate(*this,
+                                rays[i],
+                                found & (1u << i) ? &hits[i] : nullptr,
+                                sky_color, *samplers[i]);
+                            const Float32 luminance = get_luminance(color);
+                            sum              += color;
+                            luminance_sq_sum += luminance * luminance;
+                        }
+                    }
+                    accumulation.Add(u, v, sum, luminance_sq_sum,
+                        sample_count);
+                    buffer.At(u, v) = accumulation.GetMean(u, v);
+                    tile_samples += sample_count;
+                }
+            }
+            total_samples += tile_samples;
+        });
+        return total_samples;
+    }
+
+}
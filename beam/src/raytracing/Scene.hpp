@@ -0,0 +1,233 @@
+#pragma once
+#include "raytracing/Raytracing.hpp"
+#include "raytracing/Objects.hpp"
+#include "raytracing/PrimitiveArrays.hpp"
+#include "raytracing/Mesh.hpp"
+#include "raytracing/Instance.hpp"
+#include "raytracing/BVH.hpp"
+#include "raytracing/Camera.hpp"
+#include "raytracing/Integrator.hpp"
+#include "raytracing/Lights.hpp"
+#include "rendering/Color.hpp"
+#include "rendering/PixelBuffer.hpp"
+#include "rendering/AccumulationBuffer.hpp"
+#include "Sampler.hpp"
+#include "ThreadPool.hpp"
+
+namespace beam {
+
+    struct TraceSettings {
+        // The number of samples added per call to Trace to every pixel that
+        // still needs them
+        UInt32  SamplesPerPixel = 16u;
+        // Adaptive sampling: once a pixel has at least MinSamples samples,
+        // it only gets more while the relative standard error of its mean is
+        // above ErrorThreshold. A threshold of zero turns this off.
+        UInt32  MinSamples      = 16u;
+        Float32 ErrorThreshold  = 0.0f;
+        // Pixels never get more than this many samples; zero means no limit.
+        UInt32  MaxSamples      = 0u;
+
+        // The number of samples that the pixel gets in the next pass.
+        UInt32 GetSampleCount(const AccumulationBuffer& accumulation,
+            UIndex u, UIndex v) const;
+    };
+
+    class Scene : public Intersectable {
+    public:
+        Scene()
+            : m_revision(1u)
+            , m_lights(std::make_unique<LightTable>())
+        { }
+
+        // Spheres, planes and triangles go into dense per-type arrays and
+        // meshes into their own list, placed once without a transform; any
+        // other Intersectable is stored as an object behind its interface.
+        template <typename IntersectableT, typename... Args>
+        Scene& Add(Args&&... args) {
+            if constexpr (std::is_same_v<IntersectableT, Sphere>)
+                m_spheres.Add(Sphere(std::forward<Args>(args)...));
+            else if constexpr (std::is_same_v<IntersectableT, Plane>)
+                m_planes.Add(Plane(std::forward<Args>(args)...));
+            else if constexpr (std::is_same_v<IntersectableT, Triangle>)
+                m_triangles.Add(Triangle(std::forward<Args>(args)...));
+            else if constexpr (std::is_same_v<IntersectableT, Mesh>)
+                AddInstance(AddMesh(std::forward<Args>(args)...), Mat4(1.0f));
+            else
+                m_objects.emplace_back(std::make_unique<IntersectableT>(
+                    std::forward<Args>(args)...
+                ));
+            return *this;
+        }
+
+        // Adds a mesh without placing it in the scene and returns its index.
+        // The mesh is only rendered through its instances.
+        template <typename... Args>
+        UIndex AddMesh(Args&&... args) {
+            m_meshes.emplace_back(std::forward<Args>(args)...);
+            return m_meshes.size() - 1u;
+        }
+        // Places a mesh in the scene with a transform from the space of the
+        // mesh to world space and returns the index of the instance. All
+        // instances of a mesh share its triangles and BVH.
+        UIndex AddInstance(UIndex mesh, const Mat4& transform);
+        // Moves an instance. UpdateInstances needs to be called afterwards.
+        void SetInstanceTransform(UIndex instance, const Mat4& transform);
+        // Builds the top level BVH over the instances again, which is all
+        // that needs to be done after instances moved.
+        void UpdateInstances(ThreadPool* pool = nullptr);
+
+        virtual AABB GetBoundingBox() const override;
+        using Intersectable::Intersect;
+        virtual bool Intersect(const Ray& ray, Hit& hit) const override;
+        virtual Intersection GetIntersection(const Ray& ray, const Hit& hit)
+            const override;
+
+        using Intersectable::Intersects;
+        // Stops at the first hit it finds, see Intersectable::Intersects.
+        virtual bool Intersects(const Ray& ray, Float32 t_max) const override;
+
+        static constexpr UCount PacketSize = 16u;
+        // Finds the closest hits of up to PacketSize rays at once, like
+        // Intersect does for each of them. Coherent rays, like the camera
+        // rays of a pixel, traverse the hierarchies together, which visits
+        // every node once for the whole packet. Returns a bit for every ray
+        // that hit something, the first ray in the lowest bit.
+        UInt32 IntersectPacket(const Ray* rays, UCount count, Hit* hits)
+            const;
+
+        // Builds the acceleration structures over the objects added so far,
+        // in parallel if a thread pool is given. Needs to be called again
+        // after objects are added or changed. Building reorders the
+        // primitives within their arrays.
+        void Build(ThreadPool* pool = nullptr);
+        // Updates the acceleration structures after primitives moved,
+        // without changing their structure, which is much cheaper than
+        // building them again. Primitives can be changed in place through
+        // the arrays, meshes and objects. Hierarchies whose SAH cost grew
+        // to more than rebuild_threshold times their cost when they were
+        // built are built again instead. Must not be used after objects
+        // were added or removed.
+        void Refit(ThreadPool* pool = nullptr,
+            Float32 rebuild_threshold = 1.5f);
+        void Clear();
+
+        // Changes every time the scene is built or cleared.
+        inline UInt64 GetRevision() const { return m_revision; }
+
+        // The primitive arrays, for saving them or filling them in bulk.
+        // Build needs to be called after changing them.
+        inline const SphereArray&   GetSpheres() const   { return m_spheres; }
+        inline const PlaneArray&    GetPlanes() const    { return m_planes; }
+        inline const TriangleArray& GetTriangles() const {
+            return m_triangles;
+        }
+        inline SphereArray&   GetSpheres()   { return m_spheres; }
+        inline PlaneArray&    GetPlanes()    { return m_planes; }
+        inline TriangleArray& GetTriangles() { return m_triangles; }
+        inline const std::vector<Mesh>& GetMeshes() const { return m_meshes; }
+        inline std::vector<Mesh>&       GetMeshes()       { return m_meshes; }
+        inline const std::vector<Instance>& GetInstances() const {
+            return m_instances;
+        }
+        inline UCount GetObjectCount() const { return m_objects.size(); }
+        inline Intersectable& GetObject(UIndex i) { return *m_objects[i]; }
+
+        // The emissive spheres, triangles and mesh triangles, for sampling
+        // light directly. Built along with the acceleration structures.
+        inline const LightSampler& GetLights() const { return *m_lights; }
+        // Changes how lights are picked, which is a LightTable by default.
+        // The lights are collected again, so this can be called at any
+        // time.
+        void SetLightSampler(std::unique_ptr<LightSampler> lights);
+        // Returns the density in solid angle with which GetLights().Sample
+        // picks the point that was hit from the given point on a surface
+        // with the given normal, or zero if the hit isn't on one of the
+        // lights.
+        Float32 GetLightPdf(const Vec3& point, const Vec3& normal,
+            const Hit& hit, const Intersection& intersection) const;
+
+        // Writes the size, quality and build time of every acceleration
+        // structure of the scene.
+        void PrintBuildStats(std::ostream& out) const;
+
+        // Adds new samples to the pixels of the accumulation buffer that
+        // need them, spread over the threads of the pool, and writes the
+        // resulting mean of every pixel to the pixel buffer. The integrator
+        // computes the value of every sample from its camera ray, with the
+        // numbers of the sample from copies of the sampler.
+        // The accumulated samples are discarded first if the camera or the
+        // scene changed since the previous call. The result is fully
+        // determined by the sampler and the samples taken since the last
+        // reset. Returns the number of samples taken; zero means that every
+        // pixel has converged or reached the maximum number of samples.
+        UCount Trace(const Camera& camera, const Color& sky_color,
+            const Integrator& integrator, const Sampler& sampler,
+            const TraceSettings& settings, ThreadPool& pool,
+            AccumulationBuffer& accumulation, PixelBuffer& buffer) const;
+    private:
+        // Hit::Object holds the kind of object in its top bits and the index
+        // within the storage for that kind in the others.
+        enum class ObjectKind : UInt32 {
+            Sphere,
+            Plane,
+            Triangle,
+            Instance,
+            Object,
+        };
+        static constexpr UInt32
+            ObjectKindShift = 29u,
+            ObjectIndexMask = (1u << ObjectKindShift) - 1u;
+
+        static inline UInt32 MakeObjectID(ObjectKind kind, UIndex index) {
+            return (UInt32(kind) << ObjectKindShift) | UInt32(index);
+        }
+        // Lights are found by the object and primitive of a hit on them
+        static inline UInt64 MakeLightKey(UInt32 object, UInt32 primitive) {
+            return (UInt64(object) << 32u) | primitive;
+        }
+
+        // Tests the ray against the planes and the unbounded objects.
+        bool IntersectUnbounded(const Ray& ray, Hit& hit) const;
+        // Tests the ray against the leaf with the given range of positions
+        // in the hierarchy of the given kind of object.
+        bool IntersectLeaf(ObjectKind kind, UIndex first, UCount count,
+            const Ray& ray, Hit& hit) const;
+        // Returns whether the ray hits anything in the leaf closer than
+        // t_max, like IntersectLeaf does for the closest hit.
+        bool IntersectsLeaf(ObjectKind kind, UIndex first, UCount count,
+            const Ray& ray, Float32 t_max) const;
+
+        void BuildSpheres(ThreadPool* pool);
+        void BuildTriangles(ThreadPool* pool);
+        void BuildInstances(ThreadPool* pool);
+        void BuildObjects(ThreadPool* pool);
+        void BuildLights();
+
+        UInt64        m_revision;
+        SphereArray   m_spheres;
+        PlaneArray    m_planes;
+        TriangleArray m_triangles;
+        BVH           m_sphere_bvh;
+        BVH           m_triangle_bvh;
+
+        // Meshes, in the order they were added, each with its own BVH, and
+        // their instances with a BVH over them. Instances are found through
+        // the BVH in BVH order.
+        std::vector<Mesh>     m_meshes;
+        std::vector<Instance> m_instances;
+        BVH                   m_instance_bvh;
+        std::vector<UIndex>   m_instance_order;
+
+        std::vector<std::unique_ptr<Intersectable>> m_objects;
+        // Objects with finite bounds are found through the BVH, in BVH order;
+        // the others are tested for every ray.
+        BVH                 m_object_bvh;
+        std::vector<UIndex> m_bounded;
+        std::vector<UIndex> m_unbounded;
+
+        std::unique_ptr<LightSampler>      m_lights;
+        std::unordered_map<UInt64, UInt32> m_light_indices;
+    };
+
+}
@@ -0,0 +1,317 @@
+#include "Common.hpp"
+#include "Wavefront.hpp"
+
+namespace beam {
+
+    // Calls func(begin, end, thread) for consecutive chunks of [0, count)
+    // on the threads of the pool.
+    template <typename Func>
+    static void parallel_chunks(ThreadPool& pool, UCount count, Func&& func) {
+        // A multiple of the packet size, so that chunks split into whole
+        // packets
+        constexpr UCount chunk_size = 64u * Scene::PacketSize;
+        pool.ParallelFor((count + chunk_size - 1u) / chunk_size,
+            [&](UIndex chunk, UIndex thread) {
+                const UIndex begin = chunk * chunk_size;
+                func(begin, std::min(begin + chunk_size, count), thread);
+            });
+    }
+
+    // Spreads the lowest ten bits of x out to every third bit.
+    static inline UInt32 spread_bits(UInt32 x) {
+        x &= 0x3FFu;
+        x = (x | (x << 16u)) & 0x030000FFu;
+        x = (x | (x <<  8u)) & 0x0300F00Fu;
+        x = (x | (x <<  4u)) & 0x030C30C3u;
+        x = (x | (x <<  2u)) & 0x09249249u;
+        return x;
+    }
+
+    template <typename GetRayFunc>
+    void WavefrontPathTracer::Sort(std::vector<UInt32>& queue,
+            ThreadPool& pool, GetRayFunc&& get_ray) {
+        // The key of a ray is the octant of its direction in the top bits,
+        // followed by the position of its origin along a Morton curve
+        // through a grid over the bounds of the origins
+        constexpr UInt32
+            cell_bits  = 9u,
+            cell_count = 1u << cell_bits,
+            key_bits   = 3u + 3u * cell_bits;
+        const UCount count = queue.size();
+        AABB bounds = AABB::Nothing();
+        for (const UInt32 slot : queue)
+            bounds.Combine(get_ray(slot).Origin);
+        const Vec3 origin = bounds.GetMin();
+        const Vec3 extent = bounds.GetMax() - origin;
+        Vec3 scale(0.0f);
+        for (UIndex axis = 0u; axis < 3u; axis++)
+            if (extent[axis] > 0.0f)
+                scale[axis] = Float32(cell_count) / extent[axis];
+
+        m_keys.resize(count);
+        parallel_chunks(pool, count, [&](UIndex begin, UIndex end, UIndex) {
+            for (UIndex i = begin; i < end; i++) {
+                const Ray ray = get_ray(queue[i]);
+                UInt32 key = 0u;
+                for (UIndex axis = 0u; axis < 3u; axis++) {
+                    const UInt32 cell = std::min(cell_count - 1u, UInt32(
+                        (ray.Origin[axis] - origin[axis]) * scale[axis]));
+                    key |= spread_bits(cell) << axis;
+                    if (ray.Direction[axis] < 0.0f)
+                        key |= 1u << (3u * cell_bits + axis);
+                }
+                m_keys[i] = key;
+            }
+        });
+
+        // Least significant digit radix sort, which keeps rays with the
+        // same key in their order
+        constexpr UInt32
+            digit_bits  = 10u,
+            digit_count = 1u << digit_bits;
+        m_sorted.resize(count);
+        m_sorted_keys.resize(count);
+        for (UInt32 shift = 0u; shift < key_bits; shift += digit_bits) {
+            std::array<UIndex, digit_count> starts { };
+            for (const UInt32 key : m_keys)
+                starts[(key >> shift) & (digit_count - 1u)]++;
+            UIndex start = 0u;
+            for (UIndex& digit_start : starts)
+                start += std::exchange(digit_start, start);
+            for (UIndex i = 0u; i < count; i++) {
+                const UIndex to =
+                    starts[(m_keys[i] >> shift) & (digit_count - 1u)]++;
+                m_sorted[to]      = queue[i];
+                m_sorted_keys[to] = m_keys[i];
+            }
+            queue.swap(m_sorted);
+            m_keys.swap(m_sorted_keys);
+        }
+    }
+
+    UCount WavefrontPathTracer::Trace(const Scene& scene,
+            const Camera& camera, const Color& sky_color,
+            const Sampler& sampler, const TraceSettings& settings,
+            ThreadPool& pool, AccumulationBuffer& accumulation,
+            PixelBuffer& buffer) {
+        const USize
+            width  = buffer.GetWidth(),
+            height = buffer.GetHeight();
+        BEAM_DEBUG_ONLY {
+            if (accumulation.GetWidth() != width
+                    || accumulation.GetHeight() != height)
+                throw std::runtime_error("Buffer sizes don't match.");
+        }
+        accumulation.Synchronize(camera.GetRevision(), scene.GetRevision());
+
+        // Lay out the samples of all pixels one after another, in the order
+        // of the pixels
+        const UCount pixel_count = width * height;
+        m_counts.resize(pixel_count);
+        m_firsts.resize(pixel_count);
+        pool.ParallelFor(height, [&](UIndex v, UIndex) {
+            for (UIndex u = 0u; u < width; u++) {
+                const UIndex pixel = u + v * width;
+                m_counts[pixel] = settings.GetSampleCount(accumulation, u, v);
+                m_firsts[pixel] = accumulation.GetSampleCount(u, v);
+            }
+        });
+        m_offsets.resize(pixel_count + 1u);
+        m_offsets[0] = 0u;
+        for (UIndex pixel = 0u; pixel < pixel_count; pixel++)
+            m_offsets[pixel + 1u] = m_offsets[pixel] + m_counts[pixel];
+        const UCount total_samples = m_offsets.back();
+
+        m_sums.assign(pixel_count, Color(0.0f));
+        m_luminance_sq_sums.assign(pixel_count, 0.0f);
+        m_samplers.resize(pool.GetThreadCount());
+        for (auto& thread_sampler : m_samplers)
+            thread_sampler = sampler.Clone();
+
+        for (UIndex begin = 0u; begin < total_samples; begin += WaveSize) {
+            const UCount count = std::min(WaveSize, total_samples - begin);
+            Generate(camera, begin, count, width, height, pool);
+            m_queue.resize(count);
+            std::iota(m_queue.begin(), m_queue.end(), 0u);
+            for (UInt32 depth = 0u; !m_queue.empty(); depth++) {
+                // Camera rays are left in the order of their pixels, which
+                // keeps neighboring rays together even when their origins
+                // are spread over the lens
+                if (depth > 0u)
+                    Sort(m_queue, pool, [&](UInt32 slot) {
+                        return m_rays.Get(slot);
+                    });
+                Extend(scene, pool, depth == 0u);
+                Shade(scene, sky_color, pool);
+
+                m_shadow_queue.clear();
+                m_next_queue.clear();
+                for (const UInt32 slot : m_queue) {
+                    if (m_has_shadow[slot])
+                        m_shadow_queue.push_back(slot);
+                    if (m_alive[slot])
+                        m_next_queue.push_back(slot);
+                }
+                TraceShadows(scene, pool);
+                m_queue.swap(m_next_queue);
+            }
+            Accumulate(count);
+        }
+
+        pool.ParallelFor(height, [&](UIndex v, UIndex) {
+            for (UIndex u = 0u; u < width; u++) {
+                const UIndex pixel = u + v * width;
+                if (m_counts[pixel] > 0u)
+                    accumulation.Add(u, v, m_sums[pixel],
+                        m_luminance_sq_sums[pixel], m_counts[pixel]);
+                buffer.At(u, v) = accumulation.GetMean(u, v);
+            }
+        });
+        return total_samples;
+    }
+
+    void WavefrontPathTracer::Generate(const Camera& camera, UIndex begin,
+            UCount count, UCount width, UCount height, ThreadPool& pool) {
+        m_pixels.resize(count);
+        m_samples.resize(count);
+        m_dimensions.resize(count);
+        m_camera_samples.Resize(count);
+        m_hits.resize(count);
+        m_states.resize(count);
+        m_shadows.resize(count);
+        m_found.resize(count);
+        m_has_shadow.resize(count);
+        m_alive.resize(count);
+
+        const Float32
+            du = 1.0f / Float32(width),
+            dv = 1.0f / Float32(height);
+        parallel_chunks(pool, count,
+            [&](UIndex chunk_begin, UIndex chunk_end, UIndex thread) {
+                Sampler& sample = *m_samplers[thread];
+                // The pixel of the first sample of the chunk, skipping the
+                // pixels that get no samples
+                UIndex pixel = UIndex(std::upper_bound(m_offsets.begin(),
+                    m_offsets.end(), begin + chunk_begin)
+                    - m_offsets.begin()) - 1u;
+                for (UIndex slot = chunk_begin; slot < chunk_end; slot++) {
+                    const UIndex index = begin + slot;
+                    while (m_offsets[pixel + 1u] <= index)
+                        pixel++;
+                    const UInt32 sample_index =
+                        m_firsts[pixel] + UInt32(index - m_offsets[pixel]);
+                    sample.StartSample(UInt32(pixel), sample_index);
+                    const Vec2 offset = sample.GetPixel();
+                    const Float32
+                        ru = (pixel % width) * du,
+                        rv = (pixel / width) * dv;
+                    m_camera_samples.Set(slot,
+                        ru + (2.0f * offset.x - 1.0f) * du,
+                        rv + (2.0f * offset.y - 1.0f) * dv,
+                        sample.GetLens()
+                    );
+                    m_pixels[slot]     = UInt32(pixel);
+                    m_samples[slot]    = sample_index;
+                    m_dimensions[slot] = sample.GetDimension();
+                    m_states[slot]     = PathState();
+                }
+            });
+        camera.GenerateRays(m_camera_samples, m_rays);
+    }
+
+    void WavefrontPathTracer::Extend(const Scene& scene, ThreadPool& pool,
+            bool coherent) {
+        parallel_chunks(pool, m_queue.size(),
+            [&](UIndex begin, UIndex end, UIndex) {
+                if (!coherent) {
+                    for (UIndex i = begin; i < end; i++) {
+                        const UInt32 slot = m_queue[i];
+                        m_hits[slot]  = Hit();
+                        m_found[slot] = UInt8(
+                            scene.Intersect(m_rays.Get(slot), m_hits[slot]));
+                    }
+                    return;
+                }
+                constexpr UCount packet_size = Scene::PacketSize;
+                std::array<Ray, packet_size> rays;
+                std::array<Hit, packet_size> hits;
+                for (UIndex i = begin; i < end; i += packet_size) {
+                    const UCount count = std::min(packet_size, end - i);
+                    for (UIndex k = 0u; k < count; k++) {
+                        rays[k] = m_rays.Get(m_queue[i + k]);
+                        hits[k] = Hit();
+                    }
+                    const UInt32 found =
+                        scene.IntersectPacket(rays.data(), count, hits.data());
+                    for (UIndex k = 0u; k < count; k++) {
+                        const UInt32 slot = m_queue[i + k];
+                        m_hits[slot]  = hits[k];
+                        m_found[slot] = UInt8((found >> k) & 1u);
+                    }
+                }
+            });
+    }
+
+    void WavefrontPathTracer::Shade(const Scene& scene,
+            const Color& sky_color, ThreadPool& pool) {
+        parallel_chunks(pool, m_queue.size(),
+            [&](UIndex begin, UIndex end, UIndex thread) {
+                Sampler& sampler = *m_samplers[thread];
+                for (UIndex i = begin; i < end; i++) {
+                    const UInt32 slot = m_queue[i];
+                    PathState& path = m_states[slot];
+                    m_has_shadow[slot] = 0u;
+                    if (!m_found[slot]) {
+                        m_integrator.Miss(path, sky_color);
+                        m_alive[slot] = 0u;
+                        continue;
+                    }
+                    sampler.StartSample(m_pixels[slot], m_samples[slot],
+                        m_dimensions[slot]);
+                    Ray ray = m_rays.Get(slot);
+                    std::optional<ShadowRay> shadow;
+                    const bool alive = m_integrator.Shade(scene, ray,
+                        m_hits[slot], path, sampler, shadow);
+                    if (shadow) {
+                        m_shadows[slot]    = *shadow;
+                        m_has_shadow[slot] = 1u;
+                    }
+                    m_alive[slot] = UInt8(alive);
+                    if (alive) {
+                        m_rays.Set(slot, ray);
+                        m_dimensions[slot] = sampler.GetDimension();
+                    }
+                }
+            });
+    }
+
+    void WavefrontPathTracer::TraceShadows(const Scene& scene,
+            ThreadPool& pool) {
+        Sort(m_shadow_queue, pool, [&](UInt32 slot) {
+            return m_shadows[slot].Ray;
+        });
+        parallel_chunks(pool, m_shadow_queue.size(),
+            [&](UIndex begin, UIndex end, UIndex) {
+                for (UIndex i = begin; i < end; i++) {
+                    const UInt32     slot   = m_shadow_queue[i];
+                    const ShadowRay& shadow = m_shadows[slot];
+                    if (!scene.Intersects(shadow.Ray, shadow.Distance))
+                        m_states[slot].Radiance += shadow.Radiance;
+                }
+            });
+    }
+
+    void WavefrontPathTracer::Accumulate(UCount count) {
+        // The samples of a pixel are in consecutive slots, in order, so they
+        // are summed up in the same order as by Scene::Trace. Done on one
+        // thread, since chunks could split the samples of a pixel.
+        for (UIndex slot = 0u; slot < count; slot++) {
+            const UInt32  pixel     = m_pixels[slot];
+            const Color   color(m_states[slot].Radiance, 1.0f);
+            const Float32 luminance = get_luminance(color);
+            m_sums[pixel]              += color;
+            m_luminance_sq_sums[pixel] += luminance * luminance;
+        }
+    }
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "raytracing/Scene.hpp"
+
+namespace beam {
+
+    // Path tracing with the path integrator in stages over large batches
+    // of paths, instead of one path at a time from start to end (wavefront
+    // path tracing, see Laine et al., "Megakernels Considered Harmful",
+    // 2013). A wave of paths starts with the camera rays of many samples
+    // and goes through the same stages until all of its paths have ended:
+    // the rays are sorted, their closest hits are found, the paths are
+    // shaded at their hits, and the shadow rays of their light samples are
+    // traced. Every stage runs over all paths that are still going, spread
+    // over the threads, so a thread runs the same code on similar data for
+    // a long time instead of switching between stages for every path.
+    //
+    // The camera rays of a pixel are traced together in packets. Later rays
+    // go in all directions, which makes packets of them visit most of the
+    // hierarchies, so they are traced one by one, sorted by the octant of
+    // their direction and then by where they start. Rays that follow each
+    // other then take similar paths through the hierarchies and find the
+    // nodes they need in the caches.
+    //
+    // The result is the same as that of Scene::Trace with the path
+    // integrator, up to rounding.
+    class WavefrontPathTracer {
+    public:
+        // The largest number of paths in flight at once
+        static constexpr UCount WaveSize = 1u << 16;
+
+        explicit WavefrontPathTracer(const PathIntegrator& integrator)
+            : m_integrator(integrator) { }
+
+        // See Scene::Trace. The queues are kept between calls, so that they
+        // are only allocated once.
+        UCount Trace(const Scene& scene, const Camera& camera,
+            const Color& sky_color, const Sampler& sampler,
+            const TraceSettings& settings, ThreadPool& pool,
+            AccumulationBuffer& accumulation, PixelBuffer& buffer);
+    private:
+        PathIntegrator m_integrator;
+        // A copy of the sampler per thread
+        std::vector<std::unique_ptr<Sampler>> m_samplers;
+
+        // For every pixel, the number of samples it gets in this pass, the
+        // index of the first of them, and where they start among the
+        // samples of all pixels
+        std::vector<UInt32> m_counts, m_firsts;
+        std::vector<UIndex> m_offsets;
+        // The sums of the colors of the samples of every pixel and of their
+        // squared luminance
+        std::vector<Color>   m_sums;
+        std::vector<Float32> m_luminance_sq_sums;
+
+        // The paths of the wave in structure of arrays form, by slot: the
+        // sample and the dimension of the sampler it's at, the next ray,
+        // which starts out as the camera ray, and the closest hit of it
+        std::vector<UInt32>    m_pixels, m_samples, m_dimensions;
+        CameraSamples          m_camera_samples;
+        CameraRays             m_rays;
+        std::vector<Hit>       m_hits;
+        std::vector<PathState> m_states;
+        std::vector<ShadowRay> m_shadows;
+        // Whether the ray of every slot hit something, whether the path has
+        // a shadow ray to trace, and whether it goes on
+        std::vector<UInt8>     m_found, m_has_shadow, m_alive;
+
+        // The slots of the paths that go through the next stage, and space
+        // for sorting them
+        std::vector<UInt32> m_queue, m_shadow_queue, m_next_queue;
+        std::vector<UInt32> m_keys, m_sorted, m_sorted_keys;
+
+        void Generate(const Camera& camera, UIndex begin, UCount count,
+            UCount width, UCount height, ThreadPool& pool);
+        // Finds the closest hits of the rays of the queue. Coherent rays,
+        // like the camera rays of a pixel, are traced in packets.
+        void Extend(const Scene& scene, ThreadPool& pool, bool coherent);
+        void Shade(const Scene& scene, const Color& sky_color,
+            ThreadPool& pool);
+        void TraceShadows(const Scene& scene, ThreadPool& pool);
+        void Accumulate(UCount count);
+
+        // Sorts the queue by the rays that get_ray returns for its slots.
+        template <typename GetRayFunc>
+        void Sort(std::vector<UInt32>& queue, ThreadPool& pool,
+            GetRayFunc&& get_ray);
+    };
+
+}
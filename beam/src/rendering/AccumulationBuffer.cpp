@@ -0,0 +1,49 @@
+#include "Common.hpp"
+#include "AccumulationBuffer.hpp"
+
+namespace beam {
+
+    AccumulationBuffer::AccumulationBuffer(UCount width, UCount height)
+        : m_width(width)
+        , m_height(height)
+        , m_sums(width * height, Color(0.0f))
+        , m_luminance_sq_sums(width * height, 0.0)
+        , m_counts(width * height, 0u)
+        , m_camera_revision(0u)
+        , m_scene_revision(0u)
+    { }
+
+    void AccumulationBuffer::Reset() {
+        std::fill(m_sums.begin(), m_sums.end(), Color(0.0f));
+        std::fill(m_luminance_sq_sums.begin(), m_luminance_sq_sums.end(), 0.0);
+        std::fill(m_counts.begin(), m_counts.end(), 0u);
+    }
+
+    Float32 AccumulationBuffer::GetRelativeError(UIndex u, UIndex v) const {
+        // Keeps the error of nearly black pixels from blowing up
+        constexpr Float64 min_mean = 1.0e-3;
+        const UIndex  i = u + m_width * v;
+        const UInt32  n = m_counts[i];
+        if (n < 2u)
+            return std::numeric_limits<Float32>::infinity();
+        const Float64
+            mean     = get_luminance(m_sums[i]) / Float64(n),
+            variance = std::max(0.0,
+                (m_luminance_sq_sums[i] - Float64(n) * mean * mean)
+                / Float64(n - 1u)
+            );
+        return Float32(std::sqrt(variance / Float64(n))
+            / std::max(mean, min_mean));
+    }
+
+    void AccumulationBuffer::Synchronize(UInt64 camera_revision,
+            UInt64 scene_revision) {
+        if (camera_revision == m_camera_revision
+                && scene_revision == m_scene_revision)
+            return;
+        m_camera_revision = camera_revision;
+        m_scene_revision  = scene_revision;
+        Reset();
+    }
+
+}
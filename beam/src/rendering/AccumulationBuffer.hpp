@@ -0,0 +1,59 @@
+#pragma once
+#include "rendering/Color.hpp"
+#include "rendering/PixelBuffer.hpp"
+
+namespace beam {
+
+    // Running sums of the samples taken in every pixel, so that progressive
+    // rendering converges to the mean of all samples since the last reset.
+    class AccumulationBuffer {
+    public:
+        AccumulationBuffer(UCount width, UCount height);
+
+        inline UCount GetWidth()  const { return m_width;  }
+        inline UCount GetHeight() const { return m_height; }
+
+        inline UInt32 GetSampleCount(UIndex u, UIndex v) const {
+            return m_counts[u + m_width * v];
+        }
+
+        inline Color GetMean(UIndex u, UIndex v) const {
+            const UIndex i = u + m_width * v;
+            return m_counts[i] == 0u
+                ? colors::Black
+                : m_sums[i] / Float32(m_counts[i]);
+        }
+
+        // Returns the standard error of the mean luminance of a pixel,
+        // relative to that mean. Pixels with fewer than two samples have an
+        // infinite error.
+        Float32 GetRelativeError(UIndex u, UIndex v) const;
+
+        // Adds a number of new samples to a pixel, given as the sum of their
+        // colors and the sum of their squared luminances.
+        inline void Add(UIndex u, UIndex v, const Color& sum,
+                Float32 luminance_sq_sum, UInt32 count) {
+            const UIndex i = u + m_width * v;
+            m_sums[i]             += sum;
+            m_luminance_sq_sums[i] += luminance_sq_sum;
+            m_counts[i]           += count;
+        }
+
+        void Reset();
+
+        // Resets the buffer if the view it accumulates has changed since the
+        // last call, as identified by the revisions of camera and scene.
+        void Synchronize(UInt64 camera_revision, UInt64 scene_revision);
+    private:
+        UCount               m_width;
+        UCount               m_height;
+        std::vector<Color>   m_sums;
+        // Kept in double precision, as the variance is computed from the
+        // difference of two large and similar numbers
+        std::vector<Float64> m_luminance_sq_sums;
+        std::vector<UInt32>  m_counts;
+        UInt64               m_camera_revision;
+        UInt64               m_scene_revision;
+    };
+
+}
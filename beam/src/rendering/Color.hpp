@@ -4,6 +4,11 @@ namespace beam {
 
     using Color = glm::vec4;
 
+    // Returns the perceived brightness of a linear RGB color (Rec. 709).
+    inline Float32 get_luminance(const Color& color) {
+        return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+    }
+
     // Some basic colors
 
     namespace colors {
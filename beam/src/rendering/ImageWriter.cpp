@@ -0,0 +1,153 @@
+#include "Common.hpp"
+#include "ImageWriter.hpp"
+
+namespace beam {
+
+    // All binary output is little endian, like the platforms we target.
+    template <typename ValueT>
+    static void write_binary(std::ostream& stream, const ValueT& value) {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void write_string(std::ostream& stream, const std::string& str) {
+        stream.write(str.c_str(), str.size() + 1u);
+    }
+
+    static bool open_output(std::ofstream& file, const std::string& path) {
+        file.open(path, std::ios::binary);
+        if (!file.is_open() || file.bad()) {
+            std::cerr << "Can't open image file " << path << "." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool write_image(const PixelBuffer& buffer, const std::string& path) {
+        const auto extension = std::filesystem::path(path).extension();
+        if (extension == ".pfm")
+            return write_pfm(buffer, path);
+        if (extension == ".ppm")
+            return write_ppm(buffer, path);
+        if (extension == ".exr")
+            return write_exr(buffer, path);
+        std::cerr << "Unsupported image format." << std::endl;
+        return false;
+    }
+
+    bool write_pfm(const PixelBuffer& buffer, const std::string& path) {
+        std::ofstream file;
+        if (!open_output(file, path))
+            return false;
+        const UCount
+            width  = buffer.GetWidth(),
+            height = buffer.GetHeight();
+        // A negative scale marks the data as little endian
+        file << "PF\n" << width << " " << height << "\n-1.0\n";
+        // PFM stores the bottom row first
+        for (UIndex v = height; v-- > 0u;) {
+            for (UIndex u = 0u; u < width; u++) {
+                const Pixel& pixel = buffer.At(u, v);
+                write_binary(file, pixel.r);
+                write_binary(file, pixel.g);
+                write_binary(file, pixel.b);
+            }
+        }
+        return file.good();
+    }
+
+    bool write_ppm(const PixelBuffer& buffer, const std::string& path) {
+        std::ofstream file;
+        if (!open_output(file, path))
+            return false;
+        const UCount
+            width  = buffer.GetWidth(),
+            height = buffer.GetHeight();
+        file << "P6\n" << width << " " << height << "\n255\n";
+        const auto quantize = [](Float32 value) {
+            return UInt8(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+        };
+        for (UIndex v = 0u; v < height; v++) {
+            for (UIndex u = 0u; u < width; u++) {
+                const Pixel& pixel = buffer.At(u, v);
+                write_binary(file, quantize(pixel.r));
+                write_binary(file, quantize(pixel.g));
+                write_binary(file, quantize(pixel.b));
+            }
+        }
+        return file.good();
+    }
+
+    bool write_exr(const PixelBuffer& buffer, const std::string& path) {
+        std::ofstream file;
+        if (!open_output(file, path))
+            return false;
+        const Int32
+            width  = Int32(buffer.GetWidth()),
+            height = Int32(buffer.GetHeight());
+        constexpr Int32
+            pixel_type_float = 2,
+            channel_count    = 3;
+        // Channels have to be stored in alphabetical order
+        constexpr std::array<const char*, channel_count> channels {
+            "B", "G", "R"
+        };
+
+        write_binary(file, UInt32(20000630u)); // Magic number
+        write_binary(file, UInt32(2u));        // Version, single part scanline
+
+        const auto write_attribute_header = [&](const std::string& name,
+                const std::string& type, Int32 size) {
+            write_string(file, name);
+            write_string(file, type);
+            write_binary(file, size);
+        };
+        write_attribute_header("channels", "chlist", channel_count * 18 + 1);
+        for (const char* channel : channels) {
+            write_string(file, channel);
+            write_binary(file, pixel_type_float);
+            write_binary(file, UInt32(0u)); // pLinear and reserved bytes
+            write_binary(file, Int32(1));   // x sampling
+            write_binary(file, Int32(1));   // y sampling
+        }
+        write_binary(file, UInt8(0u));
+        write_attribute_header("compression", "compression", 1);
+        write_binary(file, UInt8(0u));      // No compression
+        for (const char* window : { "dataWindow", "displayWindow" }) {
+            write_attribute_header(window, "box2i", 16);
+            write_binary(file, Int32(0));
+            write_binary(file, Int32(0));
+            write_binary(file, width  - 1);
+            write_binary(file, height - 1);
+        }
+        write_attribute_header("lineOrder", "lineOrder", 1);
+        write_binary(file, UInt8(0u));      // Increasing y
+        write_attribute_header("pixelAspectRatio", "float", 4);
+        write_binary(file, 1.0f);
+        write_attribute_header("screenWindowCenter", "v2f", 8);
+        write_binary(file, 0.0f);
+        write_binary(file, 0.0f);
+        write_attribute_header("screenWindowWidth", "float", 4);
+        write_binary(file, 1.0f);
+        write_binary(file, UInt8(0u));      // End of header
+
+        // Every scanline is its own block, so the blocks have a fixed size
+        const Int32  line_size  =
+            channel_count * width * Int32(sizeof(Float32));
+        const UInt64 block_size = 2u * sizeof(Int32) + UInt64(line_size);
+        const UInt64 first_block =
+            UInt64(file.tellp()) + UInt64(height) * sizeof(UInt64);
+        for (Int32 y = 0; y < height; y++)
+            write_binary(file, first_block + UInt64(y) * block_size);
+
+        for (Int32 y = 0; y < height; y++) {
+            write_binary(file, y);
+            write_binary(file, line_size);
+            for (UIndex channel = channel_count; channel-- > 0u;)
+                for (Int32 x = 0; x < width; x++)
+                    write_binary(file,
+                        buffer.At(UIndex(x), UIndex(y))[channel]);
+        }
+        return file.good();
+    }
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "rendering/PixelBuffer.hpp"
+
+namespace beam {
+
+    // Writes the buffer to an image file, picking the format from the file
+    // extension: .pfm, .ppm or .exr.
+    bool write_image(const PixelBuffer& buffer, const std::string& path);
+
+    // Portable float map with 32 bit floating point RGB values.
+    bool write_pfm(const PixelBuffer& buffer, const std::string& path);
+    // Portable pixmap with 8 bit RGB values; colors are clamped to [0, 1].
+    bool write_ppm(const PixelBuffer& buffer, const std::string& path);
+    // Uncompressed OpenEXR with 32 bit floating point RGB channels.
+    bool write_exr(const PixelBuffer& buffer, const std::string& path);
+
+}
@@ -1,16 +1,20 @@
 #pragma once
 #include "rendering/Color.hpp"
-#include <glad/glad.h>
 
 namespace beam {
 
     using Pixel = Color;
 
+    // CPU side storage for a rendered image. Uploading it to the GPU is up to
+    // the Renderer, so a buffer can be used without any graphics context.
     class PixelBuffer {
     public:
         PixelBuffer(UCount width, UCount height);
         ~PixelBuffer();
 
+        PixelBuffer(const PixelBuffer&)            = delete;
+        PixelBuffer& operator=(const PixelBuffer&) = delete;
+
         inline UCount GetWidth()  const { return m_width;  }
         inline UCount GetHeight() const { return m_height; }
 
@@ -22,13 +26,12 @@ namespace beam {
             return m_buffer[u + m_width * (m_height - 1 - v)];
         }
 
-        void BufferData() const;
-        void BindTexture(GLuint slot) const;
+        // The pixels are stored bottom row first, as OpenGL expects them.
+        inline const Pixel* GetData() const { return m_buffer; }
     private:
         UCount m_width;
         UCount m_height;
         Pixel* m_buffer;
-        GLuint m_texture_id;
     };
 
 }
@@ -62,6 +62,7 @@ namespace beam {
 
     Renderer::Renderer()
         : m_window(nullptr)
+        , m_gl_state { 0u, 0u, 0u, 0u, 0u, 0u }
     {
         if (!glfwInit())
             throw std::runtime_error("Failed to initialize GLFW.");
@@ -120,6 +121,8 @@ namespace beam {
     }
 
     Renderer::~Renderer() {
+        if (m_gl_state.TextureID != 0u)
+            glDeleteTextures(1, &m_gl_state.TextureID);
         glDeleteProgram(m_gl_state.ShaderID);
         glDeleteBuffers(1, &m_gl_state.VBO_ID);
         glDeleteVertexArrays(1, &m_gl_state.VAO_ID);
@@ -132,10 +135,18 @@ namespace beam {
     }
 
     void Renderer::Render(const PixelBuffer& buffer) {
-        buffer.BufferData();
+        const UCount
+            width  = buffer.GetWidth(),
+            height = buffer.GetHeight();
+        if (width != m_gl_state.TextureWidth
+                || height != m_gl_state.TextureHeight)
+            ResizeTexture(width, height);
+        glTextureSubImage2D(m_gl_state.TextureID, 0, 0, 0,
+            static_cast<GLsizei>(width), static_cast<GLsizei>(height),
+            GL_RGBA, GL_FLOAT, buffer.GetData());
         glClear(GL_COLOR_BUFFER_BIT);
         glBindVertexArray(m_gl_state.VAO_ID);
-        buffer.BindTexture(0);
+        glBindTextureUnit(0, m_gl_state.TextureID);
         glUseProgram(m_gl_state.ShaderID);
         glDrawArrays(GL_TRIANGLES, 0, 6);
     }
@@ -144,4 +155,15 @@ namespace beam {
         glfwSwapBuffers(m_window);
     }
 
+    void Renderer::ResizeTexture(UCount width, UCount height) {
+        // Immutable texture storage can't be resized, so make a new texture
+        if (m_gl_state.TextureID != 0u)
+            glDeleteTextures(1, &m_gl_state.TextureID);
+        glCreateTextures(GL_TEXTURE_2D, 1, &m_gl_state.TextureID);
+        glTextureStorage2D(m_gl_state.TextureID, 1, GL_RGBA32F,
+            static_cast<GLsizei>(width), static_cast<GLsizei>(height));
+        m_gl_state.TextureWidth  = width;
+        m_gl_state.TextureHeight = height;
+    }
+
 }
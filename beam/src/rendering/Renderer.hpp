@@ -20,8 +20,11 @@ namespace beam {
         GLFWwindow* m_window;
 
         struct GLState {
-            GLuint VAO_ID, VBO_ID, ShaderID;
+            GLuint VAO_ID, VBO_ID, ShaderID, TextureID;
+            UCount TextureWidth, TextureHeight;
         } m_gl_state;
+
+        void ResizeTexture(UCount width, UCount height);
     };
 
 }
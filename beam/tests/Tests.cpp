@@ -0,0 +1,120 @@
+#include "Common.hpp"
+#include "Sampler.hpp"
+
+// Checks properties of the code that are easy to break without changing
+// how a rendered image looks at first glance. Prints every check that
+// fails and returns the number of failures.
+
+namespace beam::tests {
+
+    static UCount failures = 0u;
+
+    static void check(bool condition, const std::string& message) {
+        if (condition)
+            return;
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+
+    // Every dimension of the samples with the same index, over many pixels,
+    // should be uniform in [0, 1): a scramble that doesn't depend on enough
+    // of the digits of a value leaves some values more likely than others.
+    static void test_sampler_uniformity(const std::string& name,
+            Sampler& sampler) {
+        constexpr UCount pixel_count     = 1u << 14;
+        constexpr UCount path_dimensions = 12u;
+        constexpr UCount dimensions      = 4u + path_dimensions;
+        constexpr UInt32 indices[] { 0u, 1u, 2u, 7u, 64u, 1000u };
+        // Five standard deviations of the mean of uniform values
+        const Float64 tolerance = 5.0 * std::sqrt(1.0 / 12.0 / pixel_count);
+        for (const UInt32 index : indices) {
+            std::array<Float64, dimensions> sums   { };
+            std::array<UCount,  dimensions> zeros  { };
+            std::array<UCount,  dimensions> ranges { };
+            const auto add = [&](UIndex dimension, Float32 value) {
+                sums[dimension]   += value;
+                zeros[dimension]  += value == 0.0f;
+                ranges[dimension] += value < 0.0f || value >= 1.0f;
+            };
+            for (UInt32 pixel = 0u; pixel < pixel_count; pixel++) {
+                sampler.StartSample(pixel, index);
+                const Vec2 position = sampler.GetPixel();
+                const Vec2 lens     = sampler.GetLens();
+                add(0u, position.x);
+                add(1u, position.y);
+                add(2u, lens.x);
+                add(3u, lens.y);
+                for (UIndex d = 0u; d < path_dimensions; d += 2u) {
+                    add(4u + d, sampler.Get1D());
+                    add(5u + d, sampler.Get1D());
+                }
+            }
+            for (UIndex d = 0u; d < dimensions; d++) {
+                const std::string where = name + ", sample "
+                    + std::to_string(index) + ", dimension "
+                    + std::to_string(d);
+                const Float64 mean = sums[d] / Float64(pixel_count);
+                check(std::abs(mean - 0.5) < tolerance,
+                    where + ": mean is " + std::to_string(mean));
+                // With 24 bits, a uniform value is zero about once in 16
+                // million
+                check(zeros[d] <= 2u, where + ": "
+                    + std::to_string(zeros[d]) + " values are zero");
+                check(ranges[d] == 0u, where + ": "
+                    + std::to_string(ranges[d]) + " values are out of range");
+            }
+        }
+    }
+
+    // The samples of one pixel should cover every dimension evenly, so
+    // their mean should be much closer to a half than that of random
+    // numbers.
+    static void test_sampler_stratification(const std::string& name,
+            Sampler& sampler) {
+        constexpr UCount sample_count = 256u;
+        constexpr UCount dimensions   = 16u;
+        for (UInt32 pixel = 0u; pixel < 64u; pixel++) {
+            std::array<Float64, dimensions> sums { };
+            for (UInt32 index = 0u; index < sample_count; index++) {
+                sampler.StartSample(pixel, index);
+                const Vec2 position = sampler.GetPixel();
+                const Vec2 lens     = sampler.GetLens();
+                sums[0] += position.x;
+                sums[1] += position.y;
+                sums[2] += lens.x;
+                sums[3] += lens.y;
+                for (UIndex d = 4u; d < dimensions; d++)
+                    sums[d] += sampler.Get1D();
+            }
+            for (UIndex d = 0u; d < dimensions; d++) {
+                const Float64 mean = sums[d] / Float64(sample_count);
+                check(std::abs(mean - 0.5) < 0.01, name + ", pixel "
+                    + std::to_string(pixel) + ", dimension "
+                    + std::to_string(d) + ": mean is "
+                    + std::to_string(mean));
+            }
+        }
+    }
+
+    static void test_samplers() {
+        HaltonSampler halton(1u);
+        SobolSampler  sobol(1u);
+        test_sampler_uniformity("halton", halton);
+        test_sampler_uniformity("sobol",  sobol);
+        test_sampler_stratification("halton", halton);
+        test_sampler_stratification("sobol",  sobol);
+    }
+
+}
+
+int main() {
+    using namespace beam::tests;
+
+    test_samplers();
+    if (failures != 0u) {
+        std::cerr << failures << " checks failed." << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed." << std::endl;
+    return 0;
+}
@@ -7,6 +7,18 @@ local BIN_DIR  = OUT_DIR  ..
 local OBJ_DIR  = OUT_DIR  ..
     "/obj/%{cfg.buildcfg}-%{cfg.architecture}/%{prj.name}"
 
+newoption {
+    trigger     = "simd",
+    value       = "SET",
+    description = "Instruction set used by the SIMD intersection routines",
+    default     = "sse2",
+    allowed     = {
+        { "avx2", "AVX2, 8 lanes" },
+        { "sse2", "SSE2, 4 lanes" },
+        { "none", "Scalar code only" },
+    },
+}
+
 workspace "beam"
     architecture "x64"
     startproject "beam"
@@ -132,6 +144,132 @@ workspace "beam"
             links {
                 "gdi32",
             }
+        filter "system:linux"
+            links {
+                "pthread",
+            }
+        filter "options:simd=avx2"
+            vectorextensions "AVX2"
+        filter "options:simd=sse2"
+            vectorextensions "SSE2"
+        filter "options:simd=none"
+            defines { "BEAM_NO_SIMD" }
+        filter "configurations:debug"
+            runtime  "debug"
+            symbols  "on"
+            optimize "off"
+            defines  { "BEAM_CONFIG_DEBUG" }
+        filter "configurations:profile"
+            runtime  "release"
+            symbols  "on"
+            optimize "on"
+            defines  { "BEAM_CONFIG_PROFILE" }
+        filter "configurations:release"
+            runtime  "release"
+            symbols  "off"
+            optimize "on"
+            defines  { "BEAM_CONFIG_RELEASE" }
+
+    project "beam_bench"
+        location      "beam"
+        kind          "ConsoleApp"
+        language      "C++"
+        cppdialect    "C++17"
+        staticruntime "on"
+        systemversion "latest"
+        pchheader     "Common.hpp"
+        pchsource     (PROJ_DIR .. "/src/Common.cpp")
+        targetdir     (BIN_DIR)
+        objdir        (OBJ_DIR)
+        warnings      "extra"
+        files {
+            PROJ_DIR .. "/src/**.hpp",
+            PROJ_DIR .. "/src/**.cpp",
+            PROJ_DIR .. "/bench/**.cpp",
+        }
+        -- The benchmarks only need the raytracing code, not the window
+        removefiles {
+            PROJ_DIR .. "/src/Main.cpp",
+            PROJ_DIR .. "/src/rendering/Renderer.hpp",
+            PROJ_DIR .. "/src/rendering/Renderer.cpp",
+        }
+        includedirs {
+            PROJ_DIR .. "/src",
+            DEP_DIR  .. "/include",
+            DEP_DIR  .. "/glm/glm",
+        }
+        filter "action:vs*"
+            disablewarnings {
+                4068
+            }
+        filter "system:linux"
+            links {
+                "pthread",
+            }
+        filter "options:simd=avx2"
+            vectorextensions "AVX2"
+        filter "options:simd=sse2"
+            vectorextensions "SSE2"
+        filter "options:simd=none"
+            defines { "BEAM_NO_SIMD" }
+        filter "configurations:debug"
+            runtime  "debug"
+            symbols  "on"
+            optimize "off"
+            defines  { "BEAM_CONFIG_DEBUG" }
+        filter "configurations:profile"
+            runtime  "release"
+            symbols  "on"
+            optimize "on"
+            defines  { "BEAM_CONFIG_PROFILE" }
+        filter "configurations:release"
+            runtime  "release"
+            symbols  "off"
+            optimize "on"
+            defines  { "BEAM_CONFIG_RELEASE" }
+
+    project "beam_tests"
+        location      "beam"
+        kind          "ConsoleApp"
+        language      "C++"
+        cppdialect    "C++17"
+        staticruntime "on"
+        systemversion "latest"
+        pchheader     "Common.hpp"
+        pchsource     (PROJ_DIR .. "/src/Common.cpp")
+        targetdir     (BIN_DIR)
+        objdir        (OBJ_DIR)
+        warnings      "extra"
+        files {
+            PROJ_DIR .. "/src/**.hpp",
+            PROJ_DIR .. "/src/**.cpp",
+            PROJ_DIR .. "/tests/**.cpp",
+        }
+        -- The tests only need the raytracing code, not the window
+        removefiles {
+            PROJ_DIR .. "/src/Main.cpp",
+            PROJ_DIR .. "/src/rendering/Renderer.hpp",
+            PROJ_DIR .. "/src/rendering/Renderer.cpp",
+        }
+        includedirs {
+            PROJ_DIR .. "/src",
+            DEP_DIR  .. "/include",
+            DEP_DIR  .. "/glm/glm",
+        }
+        filter "action:vs*"
+            disablewarnings {
+                4068
+            }
+        filter "system:linux"
+            links {
+                "pthread",
+            }
+        filter "options:simd=avx2"
+            vectorextensions "AVX2"
+        filter "options:simd=sse2"
+            vectorextensions "SSE2"
+        filter "options:simd=none"
+            defines { "BEAM_NO_SIMD" }
         filter "configurations:debug"
             runtime  "debug"
             symbols  "on"